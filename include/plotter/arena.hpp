@@ -0,0 +1,63 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+
+namespace plotter
+{
+
+// Bump allocator for data that only lives during one frame. Deallocation does nothing, and reset() frees everything at once.
+// When a frame needed more than one buffer, reset() replaces them with a single one as large as all of them,
+// so that once the largest frame has been seen, frames do not allocate from upstream anymore. At most max_retained bytes
+// are kept this way : an exceptionally large frame does not hold its memory forever.
+class FrameArena : public std::pmr::memory_resource
+{
+public:
+    explicit FrameArena(std::pmr::memory_resource* upstream = std::pmr::get_default_resource(), size_t initial_size = 64 * 1024, size_t max_retained = default_max_retained);
+    FrameArena(FrameArena const&) = delete;
+    FrameArena& operator=(FrameArena const&) = delete;
+    ~FrameArena();
+
+    void reset();
+    size_t upstream_allocations() const { return m_upstream_allocations; } // Since the last reset
+    size_t used() const { return m_used; }                                 // In bytes, since the last reset
+
+    static constexpr size_t default_max_retained = 64 << 20;
+
+private:
+    struct Chunk
+    {
+        Chunk* previous;
+        size_t size; // Including this header
+    };
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override { }
+    bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override { return this == &other; }
+    void add_chunk(size_t size);
+    void release_chunks();
+
+    std::pmr::memory_resource* m_upstream;
+    Chunk* m_current;
+    size_t m_offset; // In the current chunk
+    size_t m_used;
+    size_t m_upstream_allocations;
+    size_t m_max_retained;
+};
+}
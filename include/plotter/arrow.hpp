@@ -0,0 +1,101 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <plotter/io.hpp>
+#include <vector>
+
+// Arrow C Data Interface, as specified by Apache Arrow. It is an ABI : no Arrow library is needed.
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema
+{
+    // Array type description
+    const char* format;
+    const char* name;
+    const char* metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema** children;
+    struct ArrowSchema* dictionary;
+
+    // Release callback
+    void (*release)(struct ArrowSchema*);
+    // Opaque producer-specific data
+    void* private_data;
+};
+
+struct ArrowArray
+{
+    // Array data description
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void** buffers;
+    struct ArrowArray** children;
+    struct ArrowArray* dictionary;
+
+    // Release callback
+    void (*release)(struct ArrowArray*);
+    // Opaque producer-specific data
+    void* private_data;
+};
+
+#endif // ARROW_C_DATA_INTERFACE
+
+namespace plotter
+{
+
+// Source whose points are read in place from the buffers of Arrow arrays, without any copy.
+// Supported types are integers, float32, float64, dates, timestamps and durations. Timestamps and date64 as x give
+// the source a time axis, in their own unit, so that they stay exact. Other temporal types are displayed in seconds.
+// Null values, including the ones of a parent struct, are gaps : lines are broken there. If x has nulls, it is not
+// searched as sorted.
+// The source takes ownership of the arrays and of the schemas : schemas are released once read, and arrays when the
+// source is destroyed, through their release callback. If construction throws, nothing is released.
+class ArrowSource : public ColumnSource
+{
+public:
+    ArrowSource(ArrowArray* x, ArrowSchema* x_schema, ArrowArray* y, ArrowSchema* y_schema, bool sorted_by_x = true);
+    // Children x_child and y_child of a struct array, such as an exported record batch
+    ArrowSource(ArrowArray* batch, ArrowSchema* schema, size_t x_child, size_t y_child, bool sorted_by_x = true);
+    ArrowSource(ArrowSource const&) = delete;
+    ArrowSource& operator=(ArrowSource const&) = delete;
+    ~ArrowSource();
+
+    static std::shared_ptr<ArrowSource> make(ArrowArray* x, ArrowSchema* x_schema, ArrowArray* y, ArrowSchema* y_schema, bool sorted_by_x = true);
+    static std::shared_ptr<ArrowSource> make(ArrowArray* batch, ArrowSchema* schema, size_t x_child, size_t y_child, bool sorted_by_x = true);
+
+private:
+    void use_time_axis(char const* x_format);
+
+    ArrowArray m_x;
+    ArrowArray m_y; // Released when x and y are children of the same array
+    std::vector<uint8_t> m_x_validity; // Of the children of a struct with nulls, and of the struct
+    std::vector<uint8_t> m_y_validity;
+};
+}
@@ -0,0 +1,122 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#pragma once
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <plotter/data.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace plotter
+{
+
+// Chunked files hold points sorted by x, in chunks of a fixed number of points. Each chunk has an entry in a directory,
+// at the end of the file, with its bounds and extreme points, and is followed by a summary : the first, lowest, highest
+// and last points of each of its `summary_buckets` parts. Everything is little-endian.
+struct ChunkEntry
+{
+    uint64_t offset; // In bytes, of the x, y pairs of the chunk
+    uint64_t count;
+    uint64_t summary_offset;
+    uint64_t summary_count;
+    Bounds bounds;
+    double first_x;
+    double first_y;
+    double last_x;
+    double last_y;
+    double x_of_y_min;
+    double x_of_y_max;
+};
+
+// Writes a chunked file while holding only one chunk in memory, so that it can be larger than memory.
+// Points must be appended sorted by x. The file is complete once close() has returned.
+class ChunkedWriter
+{
+public:
+    explicit ChunkedWriter(std::string const& path, size_t chunk_size = default_chunk_size);
+    ChunkedWriter(ChunkedWriter const&) = delete;
+    ChunkedWriter& operator=(ChunkedWriter const&) = delete;
+    ~ChunkedWriter(); // Closes the file if close() was not called, ignoring errors
+
+    void append(double x, double y);
+    void append(std::span<Coordinate const> points);
+    void close();
+
+    static constexpr size_t default_chunk_size = 65536;
+    static constexpr size_t summary_buckets = 32;
+
+private:
+    void write(void const* data, size_t size);
+    void flush_chunk();
+
+    std::string m_path;
+    int m_fd;
+    size_t m_chunk_size;
+    std::vector<Coordinate> m_chunk;
+    std::vector<ChunkEntry> m_directory;
+    uint64_t m_offset; // Where the next chunk goes
+    uint64_t m_count;
+    Bounds m_bounds;
+};
+
+// Source reading a chunked file on demand, for recordings larger than memory.
+// Chunks narrower than a pixel column are drawn from their directory entry, chunks narrower than summary_buckets
+// columns from their summary, and only the others are read in full. Chunks and summaries which are read are kept in a
+// cache of at most `cache_bytes`, the least recently used ones being evicted first.
+class ChunkedSource : public DataSource
+{
+public:
+    ChunkedSource(std::string const& path, size_t cache_bytes, std::pmr::memory_resource* resource);
+    ChunkedSource(ChunkedSource const&) = delete;
+    ChunkedSource& operator=(ChunkedSource const&) = delete;
+    ~ChunkedSource();
+    static std::shared_ptr<ChunkedSource> open(std::string const& path, size_t cache_bytes = default_cache_bytes, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    size_t size() const { return m_size; }
+    size_t cached_bytes() const;
+    Bounds bounds() const override { return m_bounds; }
+    bool sorted_by_x() const override { return true; }
+    std::span<Coordinate const> visible(View const& view, std::pmr::vector<Coordinate>& scratch) const override;
+    bool thread_safe() const override { return true; } // The cache is locked, and its pages come from the global heap
+
+    static constexpr size_t default_cache_bytes = 256 << 20;
+
+private:
+    using Page = std::pmr::vector<Coordinate>;
+    std::shared_ptr<Page const> page(size_t chunk, bool summary) const;
+
+    std::string m_path;
+    int m_fd;
+    std::pmr::memory_resource* m_resource;
+    std::pmr::vector<ChunkEntry> m_chunks;
+    size_t m_size;
+    size_t m_summary_buckets;
+    Bounds m_bounds;
+    size_t m_cache_bytes;
+
+    using Lru = std::list<std::pair<size_t, std::shared_ptr<Page const>>>; // Most recently used first
+    mutable std::mutex m_cache_mutex;
+    mutable Lru m_lru;
+    mutable std::unordered_map<size_t, Lru::iterator> m_cached; // By 2 * chunk + summary
+    mutable size_t m_cached_bytes;
+};
+}
@@ -0,0 +1,371 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace plotter
+{
+
+struct Coordinate
+{
+    double x;
+    double y;
+    double x_error { 0. };
+    double y_error { 0. };
+};
+
+struct Bounds
+{
+    double x_min { std::numeric_limits<double>::infinity() };
+    double x_max { -std::numeric_limits<double>::infinity() };
+    double y_min { std::numeric_limits<double>::infinity() };
+    double y_max { -std::numeric_limits<double>::infinity() };
+    bool empty() const { return x_min > x_max; }
+    void extend(double x, double y);
+    void extend(Bounds const& b);
+};
+
+// Range of x values a subplot is about to draw, and its width in pixels
+struct View
+{
+    double x_min;
+    double x_max;
+    size_t columns;
+    bool decimate;            // Whether the points may be reduced to a few per column, which is not wanted for markers
+    int64_t x_origin { 0 };   // x_min, x_max and the x of the points returned are relative to it. Only time sources see it non-zero.
+};
+
+// x of a source which are integer timestamps, such as nanoseconds since the Unix epoch
+struct TimeAxis
+{
+    int64_t origin;           // The x of the source's points and bounds are relative to it, so that they stay exact as doubles
+    int64_t units_per_second; // 1'000'000'000 for nanoseconds
+};
+
+constexpr size_t decimation_points_per_column = 4; // Sources denser than this are reduced when decimation is allowed
+
+// Keeps, for each pixel column of view, its first, lowest, highest and last points. points must be sorted by x.
+// This works in place and returns the number of points kept, at the beginning of points.
+size_t decimate(std::span<Coordinate> points, View const& view);
+
+// Anything a collection can display.
+// visible() returns the points needed to draw a view, either in the source's own storage or built into `scratch`.
+// Sources which store points take the memory resource to allocate them from, which defaults to the global heap.
+class DataSource
+{
+public:
+    virtual ~DataSource() = default;
+    virtual Bounds bounds() const = 0;
+    virtual bool sorted_by_x() const = 0;
+    virtual std::span<Coordinate const> visible(View const& view, std::pmr::vector<Coordinate>& scratch) const = 0;
+    // Called by the render loop before each frame, for sources whose points change. Returns whether they did.
+    virtual bool update() { return false; }
+    // Sources with a time axis are drawn relative to View::x_origin. The other ones are given views with x_origin = 0.
+    virtual std::optional<TimeAxis> time_axis() const { return std::nullopt; }
+    // Whether visible() may be called from other threads while the render loop uses the source, which allows prefetching.
+    // This is the case of the sources whose points never change.
+    virtual bool thread_safe() const { return false; }
+    // Whether update() can ever return true. The render loop only checks the sources periodically when one of them is
+    // dynamic : otherwise it sleeps until an event comes.
+    virtual bool dynamic() const { return false; }
+};
+
+// Called by the producers of dynamic sources, from any thread, when they have new data : wakes the render loop up, so
+// that it is shown without waiting for the next periodic check. Notifications made before the render loop has taken
+// the previous one are merged, so that calling it for each point only costs an atomic load.
+void notify_new_data();
+// Render loop side : handler is called, on the producer's thread, for the first notification not taken yet
+void set_new_data_handler(std::function<void()> handler);
+void take_new_data_notification(); // Before updating the sources, so that data arriving meanwhile notifies again
+
+// Multi-level min/max index over a sequence of y values.
+// Level 0 groups base_block points per tile, and each following level groups level_fanout tiles of the previous one.
+// A tile stores the indices of the lowest and highest point of its block, so that decimation keeps the real extrema.
+class MinMaxPyramid
+{
+public:
+    struct Tile
+    {
+        uint64_t i_min;
+        uint64_t i_max;
+    };
+    explicit MinMaxPyramid(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : m_storage(resource)
+        , m_levels(resource)
+    { }
+    MinMaxPyramid(MinMaxPyramid const&) = delete;
+    MinMaxPyramid& operator=(MinMaxPyramid const&) = delete;
+    template<typename Y>
+    void build(size_t n, Y const& y); // y(i) returns the y value of the i-th point
+    // Uses levels stored elsewhere, for example in a mapped file, which must outlive the pyramid
+    void assign(std::span<std::span<Tile const> const> levels);
+    // Calls emit(i), in increasing order, for the points of [first, last) to draw in order to render about `columns` pixel columns
+    template<typename Y, typename Emit>
+    void select(size_t first, size_t last, size_t columns, Y const& y, Emit const& emit) const;
+    size_t levels() const { return m_levels.size(); }
+    std::span<Tile const> level(size_t l) const { return m_levels[l]; }
+
+    static constexpr size_t base_block = 64;
+    static constexpr size_t level_fanout = 4;
+
+private:
+    std::pmr::vector<std::pmr::vector<Tile>> m_storage; // Empty when the levels are stored elsewhere
+    std::pmr::vector<std::span<Tile const>> m_levels;
+};
+
+// Points of a view, for points sorted by x stored anywhere, as Dataset does : a range of the points themselves, with one
+// neighbour on each side, or its decimation by the pyramid, which pyramid() is only called to get when it is needed.
+template<typename GetPyramid>
+std::span<Coordinate const> visible_sorted(std::span<Coordinate const> points, View const& view, std::pmr::vector<Coordinate>& scratch, GetPyramid const& pyramid);
+
+// Immutable set of points that can be shared by any number of collections, in any number of subplots.
+// Everything derived from the points (bounds, sort flag, decimation index) is computed once for all of them.
+class Dataset : public DataSource
+{
+public:
+    explicit Dataset(std::pmr::vector<Coordinate> points);
+    Dataset(std::span<Coordinate const> points, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    Dataset(Dataset const&) = delete;
+    Dataset& operator=(Dataset const&) = delete;
+    // The dataset is allocated from the memory resource of its points
+    static std::shared_ptr<Dataset> make(std::pmr::vector<Coordinate> points);
+    static std::shared_ptr<Dataset> make(std::span<Coordinate const> points, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    std::span<Coordinate const> points() const { return m_points; }
+    size_t size() const { return m_points.size(); }
+    Bounds bounds() const override { return m_bounds; }
+    bool sorted_by_x() const override { return m_sorted_by_x; }
+    std::span<Coordinate const> visible(View const& view, std::pmr::vector<Coordinate>& scratch) const override;
+    bool thread_safe() const override { return true; }
+    MinMaxPyramid const& pyramid() const { return m_pyramid; } // Built with the dataset, and empty if it is not sorted
+
+private:
+    std::pmr::vector<Coordinate> m_points;
+    Bounds m_bounds;
+    bool m_sorted_by_x;
+    MinMaxPyramid m_pyramid;
+};
+
+// Virtual series whose points are computed on demand, so that its memory does not depend on its length.
+// The generator must always return the same point for a given index, with x increasing with the index, and may be
+// called from several threads at once.
+class GeneratedSource : public DataSource
+{
+public:
+    using Generator = std::function<Coordinate(size_t)>;
+    GeneratedSource(size_t size, Generator generator, std::optional<Bounds> bounds = std::nullopt);
+    // Samples f at x_first, x_first + step, ... (size points)
+    static std::shared_ptr<GeneratedSource> sample(std::function<double(double)> f, double x_first, double step, size_t size, std::optional<Bounds> bounds = std::nullopt);
+
+    size_t size() const { return m_size; }
+    Bounds bounds() const override; // Needs a pass over every point if it was not given
+    bool sorted_by_x() const override { return true; }
+    std::span<Coordinate const> visible(View const& view, std::pmr::vector<Coordinate>& scratch) const override;
+    bool thread_safe() const override { return true; }
+
+private:
+    size_t m_size;
+    Generator m_generator;
+    mutable std::once_flag m_bounds_computed;
+    mutable Bounds m_bounds;
+};
+
+// Lossless compressed storage for regularly sampled series, in blocks of block_size points.
+// x are stored as delta-of-delta of their binary representation, which is almost always 0 for a regular sampling,
+// and y as the XOR with the previous value (like Gorilla does), which is small when y varies slowly.
+// Each block has a header with its bounds, so that blocks outside of the view are never decoded, and blocks
+// narrower than a pixel column are drawn from their header only. Uncertainties are not stored.
+class CompressedSource : public DataSource
+{
+public:
+    explicit CompressedSource(std::span<Coordinate const> points, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    static std::shared_ptr<CompressedSource> make(std::span<Coordinate const> points, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    static std::shared_ptr<CompressedSource> make(std::vector<double> const& x, std::vector<double> const& y, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    size_t size() const { return m_size; }
+    size_t memory() const; // In bytes
+    Bounds bounds() const override { return m_bounds; }
+    bool sorted_by_x() const override { return m_sorted_by_x; }
+    std::span<Coordinate const> visible(View const& view, std::pmr::vector<Coordinate>& scratch) const override;
+    bool thread_safe() const override { return true; }
+
+    static constexpr size_t block_size = 1024;
+
+private:
+    struct Block
+    {
+        size_t bit_offset;
+        uint32_t count;
+        Bounds bounds;
+        Coordinate first;
+        Coordinate last;
+        double x_of_y_min;
+        double x_of_y_max;
+    };
+    void decode(Block const& b, std::pmr::vector<Coordinate>& into) const;
+
+    std::pmr::vector<Block> m_blocks;
+    std::pmr::vector<uint64_t> m_bits;
+    size_t m_size;
+    Bounds m_bounds;
+    bool m_sorted_by_x;
+};
+
+template<typename Y>
+void MinMaxPyramid::build(size_t n, Y const& y)
+{
+    m_storage.clear();
+    m_levels.clear();
+    if (n <= base_block)
+        return;
+    std::pmr::vector<Tile> level(m_storage.get_allocator());
+    level.reserve((n + base_block - 1) / base_block);
+    for (size_t start = 0; start < n; start += base_block)
+    {
+        size_t end = std::min(start + base_block, n);
+        Tile t { start, start };
+        for (size_t i = start + 1; i < end; i++)
+        {
+            if (y(i) < y(t.i_min))
+                t.i_min = i;
+            if (y(i) > y(t.i_max))
+                t.i_max = i;
+        }
+        level.push_back(t);
+    }
+    m_storage.push_back(std::move(level));
+    while (m_storage.back().size() > 1)
+    {
+        std::pmr::vector<Tile> const& previous = m_storage.back();
+        std::pmr::vector<Tile> next(m_storage.get_allocator());
+        next.reserve((previous.size() + level_fanout - 1) / level_fanout);
+        for (size_t start = 0; start < previous.size(); start += level_fanout)
+        {
+            size_t end = std::min(start + level_fanout, previous.size());
+            Tile t = previous[start];
+            for (size_t i = start + 1; i < end; i++)
+            {
+                if (y(previous[i].i_min) < y(t.i_min))
+                    t.i_min = previous[i].i_min;
+                if (y(previous[i].i_max) > y(t.i_max))
+                    t.i_max = previous[i].i_max;
+            }
+            next.push_back(t);
+        }
+        m_storage.push_back(std::move(next));
+    }
+    for (auto const& l : m_storage)
+        m_levels.push_back(l);
+}
+
+template<typename Y, typename Emit>
+void MinMaxPyramid::select(size_t first, size_t last, size_t columns, Y const& y, Emit const& emit) const
+{
+    if (first >= last)
+        return;
+    // Use the coarsest level whose blocks are still smaller than a column
+    size_t const points_per_column = (last - first) / std::max<size_t>(columns, 1);
+    size_t level = 0;
+    size_t block = base_block;
+    if (m_levels.empty() || points_per_column < block)
+    {
+        for (size_t i = first; i < last; i++)
+            emit(i);
+        return;
+    }
+    while (level + 1 < m_levels.size() && block * level_fanout <= points_per_column)
+    {
+        level++;
+        block *= level_fanout;
+    }
+    size_t previous = first;
+    auto push = [&](size_t i) {
+        if (i != previous)
+            emit(i);
+        previous = i;
+    };
+    auto push_pair = [&](size_t a, size_t b) {
+        push(std::min(a, b));
+        push(std::max(a, b));
+    };
+    auto scan = [&](size_t from, size_t to) { // Partial blocks at both ends are scanned directly
+        if (from >= to)
+            return;
+        size_t i_min = from;
+        size_t i_max = from;
+        for (size_t i = from + 1; i < to; i++)
+        {
+            if (y(i) < y(i_min))
+                i_min = i;
+            if (y(i) > y(i_max))
+                i_max = i;
+        }
+        push_pair(i_min, i_max);
+    };
+
+    emit(first);
+    size_t const first_block = (first + block - 1) / block;
+    size_t const last_block = last / block;
+    if (first_block >= last_block)
+    {
+        scan(first + 1, last - 1);
+    }
+    else
+    {
+        scan(first + 1, first_block * block);
+        for (size_t b = first_block; b < last_block; b++)
+        {
+            Tile const& t = m_levels[level][b];
+            push_pair(t.i_min, t.i_max);
+        }
+        scan(last_block * block, last - 1);
+    }
+    push(last - 1);
+}
+
+template<typename GetPyramid>
+std::span<Coordinate const> visible_sorted(std::span<Coordinate const> points, View const& view, std::pmr::vector<Coordinate>& scratch, GetPyramid const& pyramid)
+{
+    // Keep one neighbour on each side so that lines reach the borders
+    auto first = std::lower_bound(points.begin(), points.end(), view.x_min, [](Coordinate const& c, double x) { return c.x < x; });
+    auto last = std::upper_bound(first, points.end(), view.x_max, [](double x, Coordinate const& c) { return x < c.x; });
+    if (first != points.begin())
+        --first;
+    if (last != points.end())
+        ++last;
+    size_t const count = last - first;
+    if (!view.decimate || count <= view.columns * decimation_points_per_column)
+        return { first, last };
+
+    size_t const i_first = first - points.begin();
+    scratch.clear();
+    pyramid().select(i_first, i_first + count, view.columns, [&points](size_t i) { return points[i].y; }, [&points, &scratch](size_t i) { scratch.push_back(points[i]); });
+    return scratch;
+}
+}
@@ -0,0 +1,219 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#pragma once
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <plotter/data.hpp>
+#include <string>
+#include <vector>
+
+namespace plotter
+{
+
+enum class DType : uint8_t
+{
+    Float32,
+    Float64,
+    Int8,
+    Int16,
+    Int32,
+    Int64,
+    UInt8,
+    UInt16,
+    UInt32,
+    UInt64,
+};
+
+size_t dtype_size(DType t);
+
+// Read-only memory mapping of a whole file. Pages are only read when they are touched.
+class MappedFile
+{
+public:
+    explicit MappedFile(std::string const& path);
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+    ~MappedFile();
+    std::byte const* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    std::byte const* m_data;
+    size_t m_size;
+};
+
+// Values of type `type`, `stride` bytes apart, starting at `base`
+struct Column
+{
+    std::byte const* base;
+    size_t stride;
+    DType type;
+    double scale { 1. };                 // Applied to integers, for example to turn timestamps into seconds
+    uint8_t const* validity { nullptr }; // Bitmap, least significant bit first : values whose bit is 0 are read as NaN
+    size_t validity_offset { 0 };        // In bits
+    int64_t origin { 0 };                // Subtracted from Int64 values before scale, so that timestamps relative to it stay exact
+
+    double operator[](size_t i) const
+    {
+        if (validity != nullptr && ((validity[(validity_offset + i) / 8] >> ((validity_offset + i) % 8)) & 1) == 0)
+            return std::numeric_limits<double>::quiet_NaN();
+        std::byte const* p = base + i * stride;
+        switch (type)
+        {
+        case DType::Float32:
+            return load<float>(p);
+        case DType::Float64:
+            return load<double>(p);
+        case DType::Int8:
+            return scale * load<int8_t>(p);
+        case DType::Int16:
+            return scale * load<int16_t>(p);
+        case DType::Int32:
+            return scale * load<int32_t>(p);
+        case DType::Int64:
+            // Wraps instead of overflowing, for origins far from the values
+            return scale * static_cast<double>(static_cast<int64_t>(static_cast<uint64_t>(raw<int64_t>(p)) - static_cast<uint64_t>(origin)));
+        case DType::UInt8:
+            return scale * load<uint8_t>(p);
+        case DType::UInt16:
+            return scale * load<uint16_t>(p);
+        case DType::UInt32:
+            return scale * load<uint32_t>(p);
+        case DType::UInt64:
+            return scale * load<uint64_t>(p);
+        }
+        return 0.;
+    }
+
+private:
+    template <typename T>
+    static T raw(std::byte const* p)
+    {
+        T v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+    template <typename T>
+    static double load(std::byte const* p)
+    {
+        return static_cast<double>(raw<T>(p));
+    }
+};
+
+// Where a column is in a raw little-endian file
+struct ColumnLayout
+{
+    DType type { DType::Float64 };
+    size_t offset { 0 }; // In bytes, from the beginning of the file
+    size_t stride { 0 }; // In bytes, between two values. 0 means values are contiguous
+};
+
+// Source whose points are read in place from two columns, for example in a mapped file.
+// If the columns are sorted by x (which is declared, not checked, as checking would read every page), only the
+// displayed range is ever read, and the bounds are the ones of the first and last x, and of a sample of the y.
+class ColumnSource : public DataSource
+{
+public:
+    ColumnSource(Column x, Column y, size_t size, bool sorted_by_x);
+
+    size_t size() const { return m_size; }
+    Bounds bounds() const override;
+    bool sorted_by_x() const override { return m_sorted_by_x; }
+    std::span<Coordinate const> visible(View const& view, std::pmr::vector<Coordinate>& scratch) const override;
+    bool thread_safe() const override { return true; }
+    std::optional<TimeAxis> time_axis() const override { return m_time_axis; }
+    // Decimation index of sorted columns, which reads every y once. Built by the first view too wide to be scanned
+    // within a frame, unless it is called before, for example from another thread. Empty if the columns are not sorted.
+    MinMaxPyramid const& pyramid() const;
+
+    static constexpr size_t bounds_sample_size = 4096;
+
+protected:
+    Column m_x;
+    std::optional<TimeAxis> m_time_axis; // Of sources whose x are Int64 timestamps, then m_x.origin is its origin
+    Column m_y;
+    size_t m_size;
+    bool m_sorted_by_x;
+    mutable std::once_flag m_bounds_computed;
+    mutable Bounds m_bounds;
+    mutable std::once_flag m_pyramid_built;
+    mutable MinMaxPyramid m_pyramid;
+    mutable std::vector<size_t> m_gap_blocks; // Blocks of the pyramid's first level holding a missing y, counted up to each block
+};
+
+// Columns of memory mapped files : raw little-endian float32 / float64 files, or NumPy .npy files
+class MappedSource : public ColumnSource
+{
+public:
+    MappedSource(std::shared_ptr<MappedFile> x_file, Column x, size_t x_size, std::shared_ptr<MappedFile> y_file, Column y, size_t y_size, bool sorted_by_x);
+
+    // x and y in the same file, for example interleaved records
+    static std::shared_ptr<MappedSource> open_raw(std::string const& path, ColumnLayout x, ColumnLayout y, bool sorted_by_x = true);
+    static std::shared_ptr<MappedSource> open_raw(std::string const& x_path, ColumnLayout x, std::string const& y_path, ColumnLayout y, bool sorted_by_x = true);
+    // Columns x_column and y_column of a 2-D array
+    static std::shared_ptr<MappedSource> open_npy(std::string const& path, size_t x_column = 0, size_t y_column = 1, bool sorted_by_x = true);
+    // Two 1-D arrays of the same length
+    static std::shared_ptr<MappedSource> open_npy(std::string const& x_path, std::string const& y_path, bool sorted_by_x = true);
+
+private:
+    std::shared_ptr<MappedFile> m_x_file;
+    std::shared_ptr<MappedFile> m_y_file;
+};
+
+// Column of a CSV file, given by its index (from 0) or by its name in the header line
+struct CsvColumn
+{
+    CsvColumn(std::integral auto i) // Not size_t, so that 0 is not taken for a null pointer
+        : index(i)
+    { }
+    CsvColumn(std::string n)
+        : name(std::move(n))
+    { }
+    CsvColumn(char const* n)
+        : name(n)
+    { }
+    std::optional<size_t> index;
+    std::string name;
+};
+
+struct CsvOptions
+{
+    char separator { ',' }; // '\t' for TSV files
+    bool header { true };   // Whether the first line holds the names of the columns
+    size_t threads { 0 };   // 0 means one per hardware thread
+};
+
+// Reads columns x and y of a CSV or TSV file into a dataset allocated from resource.
+// The file is parsed in parallel, straight into the dataset's storage. Fields cannot be quoted, and empty lines are skipped.
+std::shared_ptr<Dataset> load_csv(std::string const& path, CsvColumn x, CsvColumn y, CsvOptions options = {}, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+// Reads fields x_index and y_index of the line [begin, end), which must both be numbers
+bool parse_csv_line(char const* begin, char const* end, char separator, size_t x_index, size_t y_index, Coordinate& c);
+// Index of a column, found in the header line [begin, end) if it is given by its name. path is for error messages.
+size_t csv_column_index(CsvColumn const& column, char const* begin, char const* end, char separator, std::string const& path);
+// Reads the fields of the line [begin, end) into fields : those which are not numbers, or missing, are NaN.
+// Returns the number of fields of the line, which can be more than fields.size().
+size_t parse_csv_fields(char const* begin, char const* end, char separator, std::span<double> fields);
+}
@@ -20,13 +20,27 @@ SPDX identifier : GPL-3.0-or-later
 #include <SDL2/SDL.h>
 #include <SDL2pp/SDL2pp.hh>
 #include <array>
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <memory_resource>
 #include <optional>
+#include <plotter/arena.hpp>
+#include <plotter/arrow.hpp>
+#include <plotter/chunked.hpp>
+#include <plotter/data.hpp>
 #include <plotter/firacode.hpp>
+#include <plotter/io.hpp>
 #include <plotter/notosans.hpp>
+#include <plotter/prefetch.hpp>
+#include <plotter/shm.hpp>
+#include <plotter/sidecar.hpp>
+#include <plotter/stream.hpp>
+#include <plotter/tail.hpp>
+#include <plotter/time.hpp>
+#include <span>
 #include <string>
 #include <tuple>
 #include <unordered_map>
@@ -35,14 +49,6 @@ SPDX identifier : GPL-3.0-or-later
 namespace plotter
 {
 
-struct Coordinate
-{
-    double x;
-    double y;
-    double x_error { 0. };
-    double y_error { 0. };
-};
-
 struct Color
 {
     constexpr Color()
@@ -92,41 +98,74 @@ enum class LineStyle
 
 struct Collection
 {
-    std::vector<Coordinate> points;
-    std::string name;
+    using allocator_type = std::pmr::polymorphic_allocator<>; // So that a subplot allocates the names from its resource
+    std::shared_ptr<DataSource> data; // Shared, so copying a collection never copies its points. Replaces the former `points` vector.
+    std::pmr::string name;
     Color color;
     DisplayPoints display_points;
     DisplayLines display_lines;
     PointType point_type;
     LineStyle line_style;
     SDL2pp::Color get_color() const { return SDL2pp::Color(color.red, color.green, color.blue, 255); }
-    Collection(std::vector<double> const& x, std::vector<double> const& y, std::string const& n, DisplayPoints dp = DisplayPoints::Yes, DisplayLines dl = DisplayLines::No, PointType pt = PointType::Square, LineStyle ls = LineStyle::Solid, Color c = default_color)
-        : name(n)
+    Collection(std::shared_ptr<DataSource> d, std::string const& n, DisplayPoints dp = DisplayPoints::Yes, DisplayLines dl = DisplayLines::No, PointType pt = PointType::Square, LineStyle ls = LineStyle::Solid, Color c = default_color)
+        : data(std::move(d))
+        , name(n)
         , color(c)
         , display_points(dp)
         , display_lines(dl)
         , point_type(pt)
         , line_style(ls)
+    {
+        if (!data)
+        {
+            throw std::runtime_error("a collection needs a data source");
+        }
+    }
+    // The points are copied into a dataset allocated from r
+    Collection(std::vector<double> const& x, std::vector<double> const& y, std::string const& n, DisplayPoints dp = DisplayPoints::Yes, DisplayLines dl = DisplayLines::No, PointType pt = PointType::Square, LineStyle ls = LineStyle::Solid, Color c = default_color, std::pmr::memory_resource* r = std::pmr::get_default_resource())
+        : Collection(Dataset::make(zip(x, y, r)), n, dp, dl, pt, ls, c)
+    { }
+    Collection(std::vector<Coordinate> const& p, std::string const& n, DisplayPoints dp = DisplayPoints::Yes, DisplayLines dl = DisplayLines::No, PointType pt = PointType::Square, LineStyle ls = LineStyle::Solid, Color c = default_color, std::pmr::memory_resource* r = std::pmr::get_default_resource())
+        : Collection(Dataset::make(p, r), n, dp, dl, pt, ls, c)
+    { }
+    Collection(Collection const&) = default;
+    Collection(Collection&&) = default;
+    Collection(Collection const& c, allocator_type a)
+        : data(c.data)
+        , name(c.name, a)
+        , color(c.color)
+        , display_points(c.display_points)
+        , display_lines(c.display_lines)
+        , point_type(c.point_type)
+        , line_style(c.line_style)
+    { }
+    Collection(Collection&& c, allocator_type a)
+        : data(std::move(c.data))
+        , name(std::move(c.name), a)
+        , color(c.color)
+        , display_points(c.display_points)
+        , display_lines(c.display_lines)
+        , point_type(c.point_type)
+        , line_style(c.line_style)
+    { }
+    Collection& operator=(Collection const&) = default;
+    Collection& operator=(Collection&&) = default;
+
+private:
+    static std::pmr::vector<Coordinate> zip(std::vector<double> const& x, std::vector<double> const& y, std::pmr::memory_resource* r)
     {
         if (x.size() != y.size())
         {
             throw std::runtime_error("x and y must have the same size");
         }
+        std::pmr::vector<Coordinate> points(r);
         points.reserve(x.size());
         for (size_t i = 0; i < x.size(); i++)
         {
             points.push_back({ x[i], y[i] });
         }
+        return points;
     }
-    Collection(std::vector<Coordinate> const& p, std::string const& n, DisplayPoints dp = DisplayPoints::Yes, DisplayLines dl = DisplayLines::No, PointType pt = PointType::Square, LineStyle ls = LineStyle::Solid, Color c = default_color)
-        : points(p)
-        , name(n)
-        , color(c)
-        , display_points(dp)
-        , display_lines(dl)
-        , point_type(pt)
-        , line_style(ls)
-    { }
 };
 
 struct Function
@@ -211,16 +250,20 @@ class Plotter;
 class SubPlot
 {
 public:
-    SubPlot(Plotter& plotter, std::string const& title, std::optional<std::string> x_title, std::optional<std::string> y_title, int font_advance)
+    SubPlot(Plotter& plotter, std::string const& title, std::optional<std::string> x_title, std::optional<std::string> y_title, int font_advance, std::pmr::memory_resource* resource)
         : m_plotter(plotter)
         , m_width(800)
         , m_height(600)
-        , m_title(title)
-        , m_x_title(x_title)
-        , m_y_title(y_title)
+        , m_title(title, resource)
+        , m_x_title(x_title ? std::optional<std::pmr::string>(std::in_place, *x_title, resource) : std::nullopt)
+        , m_y_title(y_title ? std::optional<std::pmr::string>(std::in_place, *y_title, resource) : std::nullopt)
+        , m_collections(resource)
+        , m_functions(resource)
         , m_window_defined(false)
+        , m_axis(std::pmr::vector<Axis>(resource), std::pmr::vector<Axis>(resource))
         , m_dirty_axis(true)
         , m_orthonormal(Orthonormal::No)
+        , m_progress_points(resource)
         , m_small_font_advance(font_advance)
     { }
     void add_collection(Collection const& c);
@@ -237,6 +280,9 @@ public:
     }
     void set_window(double x, double y, double w, double h); // (x, y) are the coordinates of the top-left point
     void set_orthonormal(Orthonormal o = Orthonormal::Yes) { m_orthonormal = o; }
+    // Keeps the newest point at the right edge, showing `width` along x (the current width if not given).
+    // Moving along x stops following, and the F key starts again.
+    void set_follow(std::optional<double> width = std::nullopt);
 
 private:
     friend class Plotter;
@@ -253,9 +299,27 @@ private:
     };
     struct InfoLine
     {
-        std::string name;
+        std::pmr::string name;
         SDL_Color color;
     };
+    struct ContentView // What a drawing of the data is for
+    {
+        std::optional<SDL2pp::Rect> area;
+        double x_offset { 0. };
+        double y_offset { 0. };
+        double x_zoom { 0. };
+        double y_zoom { 0. };
+        bool operator==(ContentView const&) const = default;
+    };
+    struct Progress // Of a drawing within the frame budget, which goes on during the next frames if it is resumable
+    {
+        ContentView view;
+        bool resumable;
+        size_t item { 0 };  // Collection, then function
+        size_t point { 0 }; // First one of the item which is not drawn
+        std::shared_ptr<Prefetcher::Entry const> prefetched {}; // Where the points of the item come from, kept alive while they are drawn
+        std::span<Coordinate const> points {};                  // Of the item, so that the next frames draw the same ones without asking the source again
+    };
 
     // Methods that get called by Plotter
     void event_x_move(int x);
@@ -266,11 +330,31 @@ private:
     int min_height() const;
     int width() const;
     int height() const;
-    std::vector<InfoLine> infos() const;
-    std::unique_ptr<SDL2pp::Texture> internal_plot(SDL2pp::Renderer& renderer);
+    SDL2pp::Texture& internal_plot(SDL2pp::Renderer& renderer); // Drawn again only if needed
+    bool needs_redraw() const { return m_dirty || m_dirty_axis || m_progress || m_content_behind; }
+    void release_texture()
+    {
+        m_texture.reset();
+        m_content.reset();
+        m_content_spare.reset();
+        m_progress.reset();
+        m_dirty = true;
+    }
+    bool end_pan(); // Returns whether the content, which was moved, has to be drawn again
+    bool set_preview(bool preview); // Returns whether a preview has to be drawn again at full quality
     void initialize(); // This has to be called each time before a plot
+    bool update_sources(); // Once per frame, returns whether any source changed
+    bool dynamic() const;  // Whether any source is
+    void resume_follow() { m_following = m_follow; }
+    void follow_latest();
+    void rebase_x_origin(); // Moves the origin of a time axis to the view, when it went too far from it
+    int64_t x_origin() const { return m_time_axis ? m_time_axis->origin : 0; } // x of the plot are relative to it
+    Bounds source_bounds(DataSource const& d) const;                          // Relative to x_origin()
+    std::pmr::string x_label(double x, bool tick) const;                      // A time on time axes. From the frame arena.
+    View source_view(View const& view, DataSource const& d) const;            // In the x of the source
+    void prefetch_requests(std::vector<Prefetcher::Request>& into) const;     // Views around the current one
 
-    void draw_axis(std::tuple<std::vector<Axis>, std::vector<Axis>> const& axis, SDL2pp::Renderer& renderer);
+    void draw_axis(std::tuple<std::pmr::vector<Axis>, std::pmr::vector<Axis>> const& axis, SDL2pp::Renderer& renderer);
     void draw_point(Coordinate c, SDL2pp::Renderer& renderer, PointType point_type); // Absolute coordinates
     template<typename T>
     T to_plot_x(double x) const
@@ -289,13 +373,18 @@ private:
     void draw_vertical_line_number(double nb, int x, SDL2pp::Renderer& renderer);
     void draw_horizontal_line_number(double nb, int y, SDL2pp::Renderer& renderer);
     void draw_axis_titles(SDL2pp::Renderer& renderer);
-    void plot_collection(Collection const& c, SDL2pp::Renderer& renderer, SDL2pp::Texture& into);
-    void plot_function(Function const& f, SDL2pp::Renderer& renderer, SDL2pp::Texture& into);
+    // These return false if the frame deadline came first, with m_progress telling where to go on. They need m_progress.
+    bool plot_collection(Collection const& c, SDL2pp::Renderer& renderer, SDL2pp::Texture& into, std::pmr::vector<Coordinate>& scratch);
+    bool plot_function(Function const& f, SDL2pp::Renderer& renderer, SDL2pp::Texture& into, std::pmr::vector<Coordinate>& scratch);
+    bool plot_points(std::span<Coordinate const> points, SDL2pp::Color normal, DisplayPoints dp, DisplayLines dl, PointType pt, LineStyle ls, SDL2pp::Renderer& renderer, SDL2pp::Texture& into);
     ScreenPoint to_point(Coordinate const& c) const;
-    void draw_line(ScreenPoint const& p1, ScreenPoint const& p2, SDL2pp::Renderer& renderer, SDL2pp::Texture& into, size_t& lenght_drawn, SDL2pp::Texture& total_segment);
+    void draw_line(ScreenPoint const& p1, ScreenPoint const& p2, SDL2pp::Renderer& renderer, SDL2pp::Texture& into, SDL2pp::Texture& total_segment);
     void initialize_zoom_and_offset();
-    void draw_content(SDL2pp::Renderer& renderer);
-    std::tuple<std::vector<Axis>, std::vector<Axis>> determine_axis();
+    void draw_content(SDL2pp::Renderer& renderer, bool entirely);
+    bool draw_data(SDL2pp::Renderer& renderer, SDL2pp::Texture& into);      // Only inside m_clip if set, going on with m_progress
+    bool draw_data_once(SDL2pp::Renderer& renderer, SDL2pp::Texture& into); // Within the frame budget too, but given up if it does not fit
+    std::pair<int, int> drawn_columns() const;   // Of the plot area, narrowed to m_clip
+    void determine_axis(); // Fills m_axis
     double static compute_grid_step(int min_nb, int max_nb, double range);
     bool static intersect_rect_and_line(int64_t rx, int64_t ry, int64_t rw, int64_t rh, int64_t& x1, int64_t& x2, int64_t& y1, int64_t& y2);
     void static draw_circle(SDL2pp::Renderer& renderer, int x, int y, int radius);
@@ -313,16 +402,33 @@ private:
     double m_x_zoom;
     double m_y_x_ratio; // This is the interesting data
     double m_y_zoom;    // This is a cached value
-    std::string m_title;
-    std::optional<std::string> m_x_title;
-    std::optional<std::string> m_y_title;
-    std::vector<Collection> m_collections;
-    std::vector<Function> m_functions;
+    std::pmr::string m_title;
+    std::optional<std::pmr::string> m_x_title;
+    std::optional<std::pmr::string> m_y_title;
+    std::pmr::vector<Collection> m_collections;
+    std::pmr::vector<Function> m_functions;
     bool m_window_defined;
-    std::tuple<std::vector<Axis>, std::vector<Axis>> m_axis;
+    bool m_follow { false };    // Set by set_follow()
+    bool m_following { false }; // Until the user moves along x
+    std::optional<double> m_follow_width;
+    std::optional<TimeAxis> m_time_axis; // Of the first collection which has one
+    int64_t m_x_time_step { 1 };         // Between the ticks of a time axis, in its units
+    std::tuple<std::pmr::vector<Axis>, std::pmr::vector<Axis>> m_axis;
     bool m_dirty_axis;
     Orthonormal m_orthonormal;
-    std::unique_ptr<SDL2pp::Texture> m_texture;
+    std::unique_ptr<SDL2pp::Texture> m_texture; // Last drawing, reused while nothing changed
+    bool m_dirty { true };                      // Data changed, or the content has to be drawn entirely. View changes set m_dirty_axis.
+    std::unique_ptr<SDL2pp::Texture> m_content;       // The data without the axes, moved when panning
+    std::unique_ptr<SDL2pp::Texture> m_content_spare; // What the content is moved into, or drawn into over several frames
+    std::optional<Progress> m_progress;               // Of the drawing at full quality, in m_content_spare
+    std::pmr::vector<Coordinate> m_progress_points;   // Of the item in progress, when the source built them into the frame's scratch
+    std::optional<SDL2pp::Rect> m_clip;               // Set while only a strip of the content is drawn
+    ContentView m_content_view;                       // View the content was drawn for
+    bool m_preview { false };         // Drawn roughly : coarser decimation, no markers on lines, fewer samples of functions
+    bool m_content_preview { false }; // Part of the content is a preview
+    bool m_content_behind { false };  // The content is the one of a former view, as drawing the current one did not fit in a frame
+    int m_blits { 0 };                // Moves of the content since it was drawn entirely
+    double m_blit_error { 0. }; // In px, from moves which were not by whole pixels
     int m_small_font_advance;
     int m_x_label_margin;
     int m_bottom_margin;
@@ -332,12 +438,20 @@ private:
     static constexpr int hmargin = 10;
     static constexpr int line_width_unit = 1;
     static constexpr int half_point_size = 4;
+    static constexpr int dash_length = 15; // In px, as is the space between two dashes
     static constexpr double zoom_factor = 1.3;
     static constexpr int plot_min_width = 160;
     static constexpr int plot_min_height = 120;
     static constexpr double min_spacing_between_axis = 80;  // In px
     static constexpr double max_spacing_between_axis = 200; // In px
     static constexpr int sampling_number_of_points = 5'000;
+    static constexpr int max_blits = 120;                    // Then the content is drawn entirely, even while panning
+    static constexpr double max_blit_error = 0.5;            // In px
+    static constexpr int strip_margin = 2 * half_point_size; // Markers and lines around a strip reach into it
+    static constexpr int preview_column_width = 2;           // In px, per decimation column of a preview
+    static constexpr int preview_sampling_divisor = 4;       // Of the points sampled from functions
+    static constexpr size_t points_per_deadline_check = 1'024;
+    static constexpr double x_origin_rebase_distance = 0x1p40; // In units of the time axis, beyond which doubles lose their precision
 };
 
 enum class StackingDirection
@@ -346,12 +460,23 @@ enum class StackingDirection
     Vertical
 };
 
+struct FrameStats
+{
+    size_t scratch_bytes;             // Transient memory the frame took from the frame arena
+    size_t arena_upstream_allocations; // Allocations the frame arena had to make, which is 0 once the largest frame has been drawn.
+                                       // Other allocations of the frame, such as label strings and textures, are not counted.
+};
+
 class Plotter
 {
 public:
     friend class SubPlot;
-    Plotter(std::string const& title, std::optional<std::string> x_title, std::optional<std::string> y_title, ColorPalette p = ColorPalette::Default)
-        : m_running(false)
+    // Every allocation made by the plotter and its subplots uses r, so it can be released at once by the caller
+    Plotter(std::string const& title, std::optional<std::string> x_title, std::optional<std::string> y_title, ColorPalette p = ColorPalette::Default, std::pmr::memory_resource* r = std::pmr::get_default_resource())
+        : m_resource(r)
+        , m_frame_arena(r)
+        , m_last_frame_stats { 0, 0 }
+        , m_running(false)
         , m_big_font_ops(SDL2pp::RWops::FromConstMem(notosans_ttf, notosans_ttf_len))
         , m_small_font_ops(SDL2pp::RWops::FromConstMem(firacode_ttf, firacode_ttf_len))
         , m_big_font(m_big_font_ops, big_font_size)
@@ -361,6 +486,11 @@ public:
         , m_arrow_cursor(nullptr)
         , m_color_generator(p)
         , m_small_font_advance(m_small_font.GetGlyphAdvance(' '))
+        , m_infos(r)
+        , m_info_labels(r)
+        , m_info_labels_width(-1)
+        , m_mouse_text(r)
+        , m_sub_plots(r)
         , m_stacking_direction(StackingDirection::Horizontal)
     {
         construct(title, x_title, y_title);
@@ -380,8 +510,17 @@ public:
         add_function(Function { std::forward<Args>(args)... }, n);
     }
     void set_window(double x, double y, double w, double h, int n = 0); // (x, y) are the coordinates of the top-left point
+    void set_follow(std::optional<double> width = std::nullopt, int n = 0);
+    // While the user zooms or drags, frames are rough previews, drawn at full quality once inputs stopped for delay.
+    // A delay of 0 always draws at full quality.
+    void set_refine_delay(std::chrono::milliseconds delay) { m_refine_delay = delay; }
+    // While plot() runs, views around the current one are computed ahead on worker threads, and cached within bytes.
+    // 0 turns prefetching off.
+    void set_prefetch_budget(size_t bytes) { m_prefetch_budget = bytes; }
     SubPlot& add_sub_plot(std::string const& title, std::optional<std::string> x_title, std::optional<std::string> y_title);
     void set_stacking_direction(StackingDirection d) { m_stacking_direction = d; }
+    std::pmr::memory_resource* resource() const { return m_resource; }
+    FrameStats last_frame_stats() const { return m_last_frame_stats; }
 
 private:
     friend class SubPlot;
@@ -398,19 +537,25 @@ private:
     };
     void construct(std::string const& title, std::optional<std::string> x_title, std::optional<std::string> y_title);
     bool internal_plot(bool save, std::string const& name);
+    bool handle_event(SDL_Event const& event);
+    bool apply_pending_input();
     void static center_sprite(SDL2pp::Renderer& renderer, SDL2pp::Texture& texture, int x, int y);
     std::string static to_str(double nb, int digits = nb_digits);
+    SDL2pp::Surface static render_text(SDL2pp::Font& font, std::pmr::string const& text);
     int info_height() const;
     void draw_info_box(SDL2pp::Renderer& renderer);
     void static save_img(SDL2pp::Window const& window, SDL2pp::Renderer& renderer, std::string name);
     void update_mouse_position();
     size_t hovered_sub_plot() const;
-    void add_info_line(SubPlot::InfoLine const& i);
+    void add_info_line(std::string_view name, SDL_Color color);
     int base_x_of_hovered_subplot() const;
     int base_y_of_hovered_subplot() const;
     int width() const;
     int height() const;
 
+    std::pmr::memory_resource* m_resource;
+    FrameArena m_frame_arena; // Reset at the beginning of each frame
+    FrameStats m_last_frame_stats;
     bool m_running;
     SDL2pp::SDLTTF m_ttf;
     SDL2pp::RWops m_big_font_ops;
@@ -420,13 +565,27 @@ private:
     int m_mouse_x;
     int m_mouse_y;
     size_t m_subplot_mouse_selected;
+    int m_pending_x_move { 0 }; // Accumulated over the events handled since the last frame
+    int m_pending_y_move { 0 };
+    float m_pending_zoom { 0.f };
+    size_t m_pending_zoom_sub_plot { no_sub_plot_hovered };
     SDL_Cursor* m_size_cursor;
     SDL_Cursor* m_arrow_cursor;
     ColorGenerator m_color_generator;
     int m_small_font_advance;
-    std::vector<SubPlot::InfoLine> m_infos;
-    std::vector<SubPlot> m_sub_plots;
+    std::pmr::vector<SubPlot::InfoLine> m_infos;
+    std::pmr::vector<std::pmr::string> m_info_labels; // Names shortened to fit in the info box, for m_info_labels_width
+    int m_info_labels_width;
+    std::pmr::string m_mouse_text; // Kept to reuse its capacity
+    std::pmr::vector<SubPlot> m_sub_plots;
     StackingDirection m_stacking_direction;
+    std::chrono::milliseconds m_refine_delay { default_refine_delay };
+    std::chrono::steady_clock::time_point m_last_interaction {}; // Last zoom or move
+    std::chrono::steady_clock::time_point m_frame_deadline {};   // Drawings which are not complete by then go on during the next frames
+    size_t m_prefetch_budget { default_prefetch_budget };
+    std::unique_ptr<Prefetcher> m_prefetcher; // While plot() runs
+    uint32_t m_new_data_event { 0 };           // Pushed by notify_new_data(), while plot() runs
+    bool m_new_data { false };                 // Notified, and the sources not updated since
 
     static constexpr int plot_info_margin = 10;
     static constexpr int info_margin = 5;
@@ -439,5 +598,10 @@ private:
     static constexpr int nb_digits = 5;
     static constexpr int info_box_hmargin = 40;
     static constexpr size_t no_sub_plot_hovered = -1;
+    static constexpr std::chrono::milliseconds source_poll_interval { 40 }; // How often dynamic sources are checked for new data
+    static constexpr std::chrono::milliseconds min_frame_interval { 16 };
+    static constexpr std::chrono::milliseconds default_refine_delay { 150 };
+    static constexpr std::chrono::milliseconds frame_budget { 30 };
+    static constexpr size_t default_prefetch_budget = 64 << 20;
 };
 }
@@ -0,0 +1,85 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <plotter/data.hpp>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace plotter
+{
+
+// Computes, on worker threads, the points of views the user is likely to look at next, so that pans and zooms find
+// them ready instead of asking their source. Only decimated views of sources which are thread-safe and sorted by x are
+// prefetched. Results are kept in a cache of at most `budget` bytes, the least recently used being evicted first.
+// As it is filled from the worker threads, the cache is allocated from the global heap.
+class Prefetcher
+{
+public:
+    struct Request
+    {
+        std::shared_ptr<DataSource const> source;
+        View view;
+    };
+    struct Entry
+    {
+        std::shared_ptr<DataSource const> source;
+        View view;
+        std::vector<Coordinate> points; // As returned by the source, so sorted by x
+    };
+
+    explicit Prefetcher(size_t budget, size_t threads = default_threads);
+    Prefetcher(Prefetcher const&) = delete;
+    Prefetcher& operator=(Prefetcher const&) = delete;
+    ~Prefetcher(); // Waits for the views being computed
+
+    // Replaces the requests which are not started yet, which were made for an older view. The first ones are computed first.
+    // Views which are cached, or being computed, are not asked again.
+    void request(std::vector<Request> requests);
+    // A cached view from which view can be drawn, or nullptr. It has to be kept while points_in() is used.
+    std::shared_ptr<Entry const> find(DataSource const& source, View const& view);
+    // The points of entry needed to draw view, with one neighbour on each side
+    static std::span<Coordinate const> points_in(Entry const& entry, View const& view);
+    size_t cached_bytes() const;
+
+    static constexpr size_t default_threads = 2;
+    static constexpr double max_density_ratio = 4.; // Of the columns of a cached view, to the ones of the view it is used for
+
+private:
+    static bool covers(DataSource const* cached_source, View const& cached, DataSource const& source, View const& view);
+    std::shared_ptr<Entry const> find_locked(DataSource const& source, View const& view); // m_mutex is held
+    void work();
+
+    size_t m_budget;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stopping { false };
+    std::deque<Request> m_pending;
+    std::list<Request> m_in_flight; // Taken by a worker, which is computing them
+    std::list<std::shared_ptr<Entry const>> m_lru; // Most recently used first
+    size_t m_cached_bytes { 0 };
+    std::vector<std::thread> m_threads;
+};
+}
@@ -0,0 +1,107 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <plotter/data.hpp>
+#include <string>
+
+namespace plotter
+{
+
+// Layout of a ring of samples in POSIX shared memory, so that producers in any process, and any language, can feed a
+// running plot. Everything is little-endian :
+//
+//     offset  size  field
+//          0     8  magic, "PLTRING1"
+//          8     8  capacity, in samples
+//         16     8  header size, in bytes (128) : where the slots start
+//         24    40  reserved, zero
+//         64     8  write sequence : number of samples written since the ring was created
+//         72    56  reserved, zero
+//        128        2 * capacity slots of 32 bytes : x, y, x error and y error, as IEEE 754 doubles
+//
+// Sample number i is written twice, into slots i % capacity and i % capacity + capacity, so that the last `capacity`
+// samples are always contiguous. Then the write sequence is set to i + 1, with release semantics : readers load it
+// with acquire semantics, and everything before it is written. The ring is never full : samples are overwritten,
+// so readers only use the ones written long enough ago not to be overwritten while they read them.
+struct SharedRingHeader
+{
+    char magic[8];
+    uint64_t capacity;
+    uint64_t header_size;
+    uint64_t reserved[5];
+    std::atomic<uint64_t> write_sequence;
+    uint64_t reserved_after[7];
+};
+static_assert(sizeof(SharedRingHeader) == 128);
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the write sequence is shared between processes");
+static_assert(sizeof(Coordinate) == 32, "slots are used in place as coordinates");
+
+// Producer side of a shared ring : creates it, and removes it when destroyed. A ring which already exists, for example
+// left by a producer which crashed, is used again if it has the same capacity, and is never truncated.
+class SharedRing
+{
+public:
+    SharedRing(std::string const& name, size_t capacity); // name is a POSIX shared memory name, such as "/sensor"
+    SharedRing(SharedRing const&) = delete;
+    SharedRing& operator=(SharedRing const&) = delete;
+    ~SharedRing();
+
+    void push(double x, double y);
+    void push(std::span<Coordinate const> points); // Published at once
+
+private:
+    std::string m_name;
+    SharedRingHeader* m_header;
+    Coordinate* m_slots;
+    size_t m_bytes;
+};
+
+// Source displaying a shared ring. x must increase. Only the last `capacity - guard` samples are displayed : guard is
+// capacity / 4 by default, and must be larger than the batches the producer pushes at once. The visible points are
+// copied, then the ones the producer may have overwritten while they were copied are dropped, so that nothing torn is
+// ever drawn. Bounds cover every sample seen since attaching.
+class SharedRingSource : public DataSource
+{
+public:
+    explicit SharedRingSource(std::string const& name, size_t guard = 0);
+    SharedRingSource(SharedRingSource const&) = delete;
+    SharedRingSource& operator=(SharedRingSource const&) = delete;
+    ~SharedRingSource();
+    static std::shared_ptr<SharedRingSource> attach(std::string const& name, size_t guard = 0);
+
+    bool update() override;
+    bool dynamic() const override { return true; }
+    std::span<Coordinate const> points() const; // In place : the producer may be overwriting the oldest ones
+    Bounds bounds() const override { return m_bounds; }
+    bool sorted_by_x() const override { return true; }
+    std::span<Coordinate const> visible(View const& view, std::pmr::vector<Coordinate>& scratch) const override;
+
+private:
+    SharedRingHeader const* m_header;
+    Coordinate const* m_slots;
+    size_t m_bytes;
+    uint64_t m_capacity;
+    uint64_t m_guard;
+    uint64_t m_sequence; // Write sequence at the last update()
+    Bounds m_bounds;
+};
+}
@@ -0,0 +1,60 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#pragma once
+#include <functional>
+#include <memory>
+#include <plotter/data.hpp>
+#include <plotter/io.hpp>
+#include <string>
+
+namespace plotter
+{
+
+// Dataset saved with its bounds and min/max pyramid into a sidecar file, which is memory mapped when it is opened :
+// reopening a dataset costs neither parsing, nor sorting checks, nor building the pyramid, and pages are only read when
+// they are displayed. A sidecar records the size and modification time of the file the dataset was read from,
+// so that it is not used anymore once that file has changed.
+class SidecarSource : public DataSource
+{
+public:
+    explicit SidecarSource(std::string const& path); // Throws if path is not a sidecar
+
+    // Maps the sidecar of source_path if it is up to date. Otherwise, reads source_path with load, and writes its
+    // sidecar for the next time : failing to write it is not an error, as it is only a cache.
+    static std::shared_ptr<DataSource> open(std::string const& source_path, std::function<std::shared_ptr<Dataset>(std::string const&)> const& load);
+    static void write(std::string const& path, Dataset const& data, std::string const& source_path);
+    static bool up_to_date(std::string const& path, std::string const& source_path);
+    static std::string path_for(std::string const& source_path) { return source_path + extension; }
+
+    size_t size() const { return m_points.size(); }
+    Bounds bounds() const override { return m_bounds; }
+    bool sorted_by_x() const override { return m_sorted_by_x; }
+    std::span<Coordinate const> visible(View const& view, std::pmr::vector<Coordinate>& scratch) const override;
+    bool thread_safe() const override { return true; }
+
+    static constexpr char const* extension = ".plotcache";
+
+private:
+    MappedFile m_file;
+    std::span<Coordinate const> m_points;
+    Bounds m_bounds;
+    bool m_sorted_by_x;
+    MinMaxPyramid m_pyramid;
+};
+}
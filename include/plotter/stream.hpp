@@ -0,0 +1,240 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#pragma once
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <plotter/data.hpp>
+#include <random>
+
+namespace plotter
+{
+
+// Lock-free queue of points between one producer thread and one consumer thread, of fixed capacity
+class SpscQueue
+{
+public:
+    explicit SpscQueue(size_t capacity, std::pmr::memory_resource* resource = std::pmr::get_default_resource()); // Rounded up to a power of 2
+    SpscQueue(SpscQueue const&) = delete;
+    SpscQueue& operator=(SpscQueue const&) = delete;
+
+    // Producer side : returns how many points were pushed, which is less than asked when the queue is full
+    size_t try_push(std::span<Coordinate const> points);
+    // Consumer side : calls f(span) on the queued points, in one or two parts, then frees their room
+    template<typename F>
+    size_t drain(F const& f);
+    size_t capacity() const { return m_buffer.size(); }
+    // Either side : the head is read first, as it only grows towards the tail, so the result never underflows
+    size_t size() const
+    {
+        size_t const head = m_head.load(std::memory_order_acquire);
+        size_t const tail = m_tail.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+private:
+    std::pmr::vector<Coordinate> m_buffer;
+    size_t m_mask;
+    alignas(64) std::atomic<size_t> m_head; // Next point to pop, written by the consumer
+    alignas(64) std::atomic<size_t> m_tail; // Next room to fill, written by the producer
+    alignas(64) size_t m_cached_head;       // Producer's copy of m_head, refreshed only when the queue looks full
+};
+
+// What a stream keeps of the points it was given
+enum class Retention : uint8_t
+{
+    All,    // Every point, forever
+    Latest, // The last `capacity` points : older ones are evicted in O(1), and memory does not grow
+    Sample, // A uniform random sample of `capacity` points of the whole stream, with the exact bounds of the stream
+};
+
+struct StreamOptions
+{
+    size_t queue_capacity { 1 << 16 }; // Points that can wait for the next frame
+    Retention retention { Retention::All };
+    size_t capacity { 0 }; // Points kept, for Retention::Latest and Retention::Sample
+    uint64_t seed { 0 };   // Of the random choices of Retention::Sample
+};
+
+// Source for live data : acquisition threads push points while the plot is displayed, and the render loop takes
+// them in once per frame, in update(). Pushing never blocks : when the render loop falls behind and the queue is
+// full, push() returns false and the points are counted as dropped, so the producer decides what to do. Pushing
+// wakes the render loop up.
+// One thread at a time may push. The points kept are sorted by x if they were pushed in increasing x.
+class StreamSource : public DataSource
+{
+public:
+    explicit StreamSource(StreamOptions options = {}, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    static std::shared_ptr<StreamSource> make(StreamOptions options = {}, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    // Producer side
+    bool push(double x, double y);
+    size_t push(std::span<Coordinate const> points); // Returns how many points were queued
+    uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+    size_t pending() const { return m_queue.size(); }
+
+    // Render loop side
+    bool update() override;
+    bool dynamic() const override { return true; }
+    size_t size() const { return m_options.retention == Retention::Sample ? m_points.size() : m_total - window_start(); }
+    uint64_t total() const { return m_total; } // Points taken in since the beginning, including evicted ones
+    std::span<Coordinate const> points() const;
+    Bounds bounds() const override;
+    bool sorted_by_x() const override { return m_last_inversion <= window_start(); }
+    std::span<Coordinate const> visible(View const& view, std::pmr::vector<Coordinate>& scratch) const override;
+
+    static constexpr size_t max_aggregated_views = 4; // Views whose column aggregates are kept
+
+private:
+    // First, lowest, highest and last of the points of one column of the aggregation grid
+    struct ColumnAggregate
+    {
+        uint64_t count { 0 };
+        uint64_t i_first { 0 };
+        uint64_t i_low { 0 };
+        uint64_t i_high { 0 };
+        uint64_t i_last { 0 };
+        Coordinate first { 0., 0. };
+        Coordinate low { 0., 0. };
+        Coordinate high { 0., 0. };
+        Coordinate last { 0., 0. };
+        void add(uint64_t i, Coordinate const& c);
+    };
+    // Aggregates of the columns of one view, on a grid of columns column_width wide starting at x = 0, so that they
+    // stay valid when the view moves without zooming. They hold every point taken before aggregated_until : new points
+    // are added to them, and only the columns which come into view are computed from the points.
+    struct ViewAggregates
+    {
+        explicit ViewAggregates(std::pmr::memory_resource* resource)
+            : columns(resource)
+        { }
+        std::pmr::deque<ColumnAggregate> columns;
+        int64_t first_column { 0 };
+        double column_width { 0. };
+        int64_t x_origin { 0 };
+        uint64_t aggregated_until { 0 };
+        uint64_t aggregated_from { 0 }; // Start of the window when the aggregates were last updated
+        uint64_t last_used { 0 };
+        int64_t column_of(double x) const { return static_cast<int64_t>(std::floor(x / column_width)); }
+    };
+
+    void take(Coordinate const& c);
+    void sample(Coordinate const& c);
+    void merge_sample();
+    std::span<Coordinate const> aggregated(View const& view, std::pmr::vector<Coordinate>& scratch) const;
+    ViewAggregates& aggregates_of(View const& view, double column_width) const;
+    void aggregate_columns(ViewAggregates const& a, int64_t first, int64_t last, std::pmr::vector<ColumnAggregate>& into) const;
+    uint64_t window_start() const { return m_options.retention == Retention::Latest && m_total > m_options.capacity ? m_total - m_options.capacity : 0; }
+    Coordinate const& at(uint64_t i) const; // By index since the beginning
+    // Indices of the points, in the window, whose values are monotonic : the front one is the extremum of the window
+    void track(std::pmr::deque<uint64_t>& extremes, uint64_t i, double Coordinate::*axis, bool lowest);
+
+    StreamOptions m_options;
+    SpscQueue m_queue;
+    std::atomic<uint64_t> m_dropped;
+    // Every point for Retention::All. For Retention::Latest, a ring where each point is written twice, at i and at
+    // i + capacity, so that the last `capacity` points are always contiguous.
+    std::pmr::vector<Coordinate> m_points;
+    uint64_t m_total;
+    uint64_t m_last_inversion; // Index of the last point whose x is lower than the previous one, 0 if none
+    double m_last_x;
+    Bounds m_bounds; // For Retention::All and Retention::Sample
+
+    // Reservoir sampling with Algorithm L : the number of points skipped before the next one replaces a random point
+    // of the sample is drawn directly, so that most points cost nothing. The sample is kept in the order of the
+    // stream : points replaced during an update() are only removed, and the new ones appended, at its end.
+    std::mt19937_64 m_random;
+    double m_w { 0. };
+    uint64_t m_next_sampled { 0 };
+    std::pmr::vector<int64_t> m_replaced_by; // For each point of the sample, index in m_incoming of its replacement, or -1
+    std::pmr::vector<Coordinate> m_incoming;
+    std::pmr::deque<uint64_t> m_x_min;
+    std::pmr::deque<uint64_t> m_x_max;
+    std::pmr::deque<uint64_t> m_y_min;
+    std::pmr::deque<uint64_t> m_y_max;
+
+    // Aggregates of the last views, so that subplots showing the same stream at different zooms or places do not
+    // compute each other's again : the least recently used ones are replaced. They are only used by the render loop.
+    mutable std::pmr::vector<ViewAggregates> m_aggregates;
+    mutable uint64_t m_aggregates_clock { 0 };
+};
+
+// Source whose points are all replaced at once, for example by each step of a simulation.
+// The writer fills back() then publish()es it, and the render loop switches to the newest published frame before
+// drawing. Three buffers are swapped with an atomic exchange, so neither side waits, the frame being drawn is never
+// written, and buffers keep their storage from one frame to the next. One thread at a time may write.
+class FrameSource : public DataSource
+{
+public:
+    explicit FrameSource(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    static std::shared_ptr<FrameSource> make(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    // Writer side : back() holds an older frame, to overwrite
+    std::pmr::vector<Coordinate>& back() { return m_frames[m_back].points; }
+    void publish(); // Bounds and decimation index are computed here, on the writer's thread
+    void publish(std::span<Coordinate const> points);
+
+    // Render loop side
+    bool update() override;
+    bool dynamic() const override { return true; }
+    std::span<Coordinate const> points() const { return m_frames[m_front].points; }
+    Bounds bounds() const override { return m_frames[m_front].bounds; }
+    bool sorted_by_x() const override { return m_frames[m_front].sorted_by_x; }
+    std::span<Coordinate const> visible(View const& view, std::pmr::vector<Coordinate>& scratch) const override;
+
+private:
+    struct Frame
+    {
+        explicit Frame(std::pmr::memory_resource* resource)
+            : points(resource)
+            , pyramid(resource)
+        { }
+        std::pmr::vector<Coordinate> points;
+        Bounds bounds;
+        bool sorted_by_x { true };
+        MinMaxPyramid pyramid;
+    };
+    static constexpr uint8_t fresh = 4; // Set along the index of the ready frame until the render loop takes it
+
+    std::array<Frame, 3> m_frames;
+    uint8_t m_back;               // Owned by the writer
+    uint8_t m_front;              // Owned by the render loop
+    std::atomic<uint8_t> m_ready; // Exchanged by both
+};
+
+template<typename F>
+size_t SpscQueue::drain(F const& f)
+{
+    size_t const head = m_head.load(std::memory_order_relaxed);
+    size_t const tail = m_tail.load(std::memory_order_acquire);
+    size_t const count = tail - head;
+    if (count == 0)
+        return 0;
+    size_t const start = head & m_mask;
+    size_t const first_part = std::min(count, m_buffer.size() - start);
+    f(std::span<Coordinate const> { m_buffer.data() + start, first_part });
+    if (first_part < count)
+        f(std::span<Coordinate const> { m_buffer.data(), count - first_part });
+    m_head.store(tail, std::memory_order_release);
+    return count;
+}
+}
@@ -0,0 +1,105 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#pragma once
+#include <memory>
+#include <optional>
+#include <plotter/data.hpp>
+#include <plotter/io.hpp>
+#include <plotter/stream.hpp>
+#include <string>
+#include <variant>
+
+namespace plotter
+{
+
+// Source following a file which is appended to, such as a log, the way `tail -f` does. The file is watched with
+// inotify, and each frame only the bytes appended since the last one are read and parsed : refreshing costs as much
+// as the new data, whatever the size of the file. The points are kept by a StreamSource, so that bounds and
+// per-column aggregates are updated incrementally, with the same retentions.
+// A file truncated is read again from its beginning. A file replaced, for example by log rotation, is read from the
+// beginning of the new file, after the points of the old one. Errors while following the file, such as a new file
+// whose header lacks the columns, do not throw : the points read so far are kept, and error() tells what happened.
+// Lines longer than max_line_size are dropped.
+class TailSource : public DataSource
+{
+public:
+    struct Csv
+    {
+        CsvColumn x { 0 };
+        CsvColumn y { 1 };
+        CsvOptions options {}; // options.threads is not used
+    };
+    // Records of record_size bytes, x and y being at the offsets given by their layouts, which have no stride
+    struct Raw
+    {
+        ColumnLayout x { DType::Float64, 0 };
+        ColumnLayout y { DType::Float64, 8 };
+        size_t record_size { 16 };
+    };
+
+    TailSource(std::string const& path, std::variant<Csv, Raw> format, StreamOptions options = {}, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    TailSource(TailSource const&) = delete;
+    TailSource& operator=(TailSource const&) = delete;
+    ~TailSource();
+    static std::shared_ptr<TailSource> csv(std::string const& path, CsvColumn x = 0, CsvColumn y = 1, CsvOptions csv_options = {}, StreamOptions options = {});
+    static std::shared_ptr<TailSource> raw(std::string const& path, ColumnLayout x = { DType::Float64, 0 }, ColumnLayout y = { DType::Float64, 8 }, size_t record_size = 16, StreamOptions options = {});
+
+    bool update() override;
+    bool dynamic() const override { return true; }
+    uint64_t offset() const { return m_offset; } // Bytes of the file read so far
+    std::optional<std::string> const& error() const { return m_error; } // The last one, until a new file is opened
+    StreamSource const& points() const { return *m_stream; }
+    Bounds bounds() const override { return m_stream->bounds(); }
+    bool sorted_by_x() const override { return m_stream->sorted_by_x(); }
+    std::span<Coordinate const> visible(View const& view, std::pmr::vector<Coordinate>& scratch) const override { return m_stream->visible(view, scratch); }
+
+    static constexpr size_t read_size = 1 << 20;
+    static constexpr size_t max_line_size = 1 << 20;
+
+private:
+    void open();
+    void restart();
+    bool replaced() const; // Whether the path now names another file
+    bool read_appended();
+    char const* parse(char const* begin, char const* end); // Returns where the incomplete line or record starts
+    char const* parse_csv(char const* begin, char const* end, Csv const& csv);
+    char const* parse_raw(char const* begin, char const* end, Raw const& raw);
+    void add(Coordinate const& c);
+    void flush();
+
+    std::string m_path;
+    std::variant<Csv, Raw> m_format;
+    StreamOptions m_options;
+    std::pmr::memory_resource* m_resource;
+    int m_fd;
+    int m_inotify; // -1 if inotify is not available : then the file is checked each frame
+    int m_watch;
+    int m_directory_watch; // For a new file at m_path
+    std::string m_file_name;
+    uint64_t m_offset;
+    std::optional<size_t> m_x_index; // Known once the header line is read
+    std::optional<size_t> m_y_index;
+    std::pmr::vector<char> m_buffer;  // The incomplete line or record at the end of the data read, then new data
+    bool m_dropping_line { false };   // Until the end of a line which was too long
+    bool m_skipping { false };        // The columns are not in the file : it is not read until it is replaced
+    std::optional<std::string> m_error;
+    std::pmr::vector<Coordinate> m_batch;
+    std::shared_ptr<StreamSource> m_stream;
+};
+}
@@ -0,0 +1,67 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <plotter/data.hpp>
+#include <string>
+
+namespace plotter
+{
+
+// Source whose x are int64 timestamps, kept as they are : converting them to doubles would lose precision (beyond
+// about 104 days at nanosecond resolution), and would cost a pass over every point. Only the points drawn are
+// converted, relative to the origin of the subplot, with exact integer arithmetic. The subplot's x axis then shows
+// dates and times, in UTC.
+class TimeSource : public DataSource
+{
+public:
+    static constexpr int64_t nanoseconds = 1'000'000'000;
+
+    // x are in units of 1 / units_per_second seconds since the Unix epoch
+    TimeSource(std::pmr::vector<int64_t> x, std::pmr::vector<double> y, int64_t units_per_second = nanoseconds);
+    TimeSource(TimeSource const&) = delete;
+    TimeSource& operator=(TimeSource const&) = delete;
+    static std::shared_ptr<TimeSource> make(std::span<int64_t const> x, std::span<double const> y, int64_t units_per_second = nanoseconds, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    size_t size() const { return m_x.size(); }
+    std::span<int64_t const> x() const { return m_x; }
+    std::span<double const> y() const { return m_y; }
+    Bounds bounds() const override { return m_bounds; } // Relative to time_axis()->origin
+    bool sorted_by_x() const override { return m_sorted_by_x; }
+    std::optional<TimeAxis> time_axis() const override { return TimeAxis { m_origin, m_units_per_second }; }
+    std::span<Coordinate const> visible(View const& view, std::pmr::vector<Coordinate>& scratch) const override;
+    bool thread_safe() const override { return true; }
+
+private:
+    std::pmr::vector<int64_t> m_x;
+    std::pmr::vector<double> m_y;
+    int64_t m_units_per_second;
+    int64_t m_origin; // The smallest x
+    Bounds m_bounds;
+    bool m_sorted_by_x;
+    MinMaxPyramid m_pyramid;
+};
+
+// Ticks of a time axis : the smallest round duration, in units, which gives at most max_nb ticks over range units
+int64_t time_grid_step(int max_nb, double range, int64_t units_per_second);
+// t in units of 1 / units_per_second seconds since the Unix epoch, in UTC, down to resolution units
+std::pmr::string time_str(int64_t t, int64_t units_per_second, int64_t resolution, bool with_date, std::pmr::memory_resource* resource);
+}
@@ -0,0 +1,102 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#include <algorithm>
+#include <cstdint>
+#include <plotter/arena.hpp>
+
+namespace plotter
+{
+
+using namespace std;
+
+namespace
+{
+constexpr size_t chunk_alignment = alignof(max_align_t);
+constexpr size_t header_size = (sizeof(void*) + sizeof(size_t) + chunk_alignment - 1) / chunk_alignment * chunk_alignment;
+}
+
+FrameArena::FrameArena(pmr::memory_resource* upstream, size_t initial_size, size_t max_retained)
+    : m_upstream(upstream)
+    , m_current(nullptr)
+    , m_offset(0)
+    , m_used(0)
+    , m_upstream_allocations(0)
+    , m_max_retained(max(max_retained, header_size + 1))
+{
+    add_chunk(header_size + initial_size);
+    m_upstream_allocations = 0;
+}
+
+FrameArena::~FrameArena()
+{
+    release_chunks();
+}
+
+void FrameArena::reset()
+{
+    size_t total = 0;
+    for (Chunk* c = m_current; c != nullptr; c = c->previous)
+        total += c->size;
+    if (m_current->previous != nullptr || total > m_max_retained)
+    {
+        release_chunks();
+        add_chunk(min(total, m_max_retained));
+    }
+    m_offset = header_size;
+    m_used = 0;
+    m_upstream_allocations = 0;
+}
+
+void* FrameArena::do_allocate(size_t bytes, size_t alignment)
+{
+    auto align = [this, alignment]() {
+        auto const base = reinterpret_cast<uintptr_t>(m_current);
+        return ((base + m_offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+    };
+    size_t aligned = align();
+    if (aligned + bytes > m_current->size)
+    {
+        add_chunk(max(2 * m_current->size, header_size + bytes + alignment));
+        aligned = align();
+    }
+    m_offset = aligned + bytes;
+    m_used += bytes;
+    return reinterpret_cast<byte*>(m_current) + aligned;
+}
+
+void FrameArena::add_chunk(size_t size)
+{
+    auto* c = static_cast<Chunk*>(m_upstream->allocate(size, chunk_alignment));
+    c->previous = m_current;
+    c->size = size;
+    m_current = c;
+    m_offset = header_size;
+    m_upstream_allocations++;
+}
+
+void FrameArena::release_chunks()
+{
+    while (m_current != nullptr)
+    {
+        Chunk* previous = m_current->previous;
+        m_upstream->deallocate(m_current, m_current->size, chunk_alignment);
+        m_current = previous;
+    }
+}
+}
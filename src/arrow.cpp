@@ -0,0 +1,242 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <plotter/arrow.hpp>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace plotter
+{
+
+using namespace std;
+
+namespace
+{
+// Moving a structure of the C data interface leaves the original released
+template <typename T>
+T take(T* from)
+{
+    T to = *from;
+    from->release = nullptr;
+    return to;
+}
+
+template <typename T>
+void release(T& t)
+{
+    if (t.release != nullptr)
+        t.release(&t);
+}
+
+void check(ArrowArray const* array, ArrowSchema const* schema)
+{
+    if (array == nullptr || schema == nullptr || array->release == nullptr || schema->release == nullptr)
+        throw runtime_error("released or missing Arrow array");
+}
+
+// Type and scale, to seconds for temporal types, of an Arrow format string
+pair<DType, double> arrow_type(string_view format)
+{
+    if (format.size() == 1)
+        switch (format[0])
+        {
+        case 'c':
+            return { DType::Int8, 1. };
+        case 'C':
+            return { DType::UInt8, 1. };
+        case 's':
+            return { DType::Int16, 1. };
+        case 'S':
+            return { DType::UInt16, 1. };
+        case 'i':
+            return { DType::Int32, 1. };
+        case 'I':
+            return { DType::UInt32, 1. };
+        case 'l':
+            return { DType::Int64, 1. };
+        case 'L':
+            return { DType::UInt64, 1. };
+        case 'f':
+            return { DType::Float32, 1. };
+        case 'g':
+            return { DType::Float64, 1. };
+        }
+    if (format == "tdD")
+        return { DType::Int32, 86400. };
+    if (format == "tdm")
+        return { DType::Int64, 1e-3 };
+    // Timestamps ("tss:", followed by a time zone) and durations ("tDs")
+    if (format.size() >= 3 && (format.starts_with("ts") || format.starts_with("tD")) && (format.size() == 3 || format[3] == ':'))
+        switch (format[2])
+        {
+        case 's':
+            return { DType::Int64, 1. };
+        case 'm':
+            return { DType::Int64, 1e-3 };
+        case 'u':
+            return { DType::Int64, 1e-6 };
+        case 'n':
+            return { DType::Int64, 1e-9 };
+        }
+    throw runtime_error("unsupported Arrow format \"" + string(format) + "\"");
+}
+
+// Units per second of timestamps and date64, whose values are from the Unix epoch
+optional<int64_t> epoch_units(string_view format)
+{
+    if (format == "tdm")
+        return 1'000;
+    if (format.size() >= 3 && format.starts_with("ts") && (format.size() == 3 || format[3] == ':'))
+        switch (format[2])
+        {
+        case 's':
+            return 1;
+        case 'm':
+            return 1'000;
+        case 'u':
+            return 1'000'000;
+        case 'n':
+            return 1'000'000'000;
+        }
+    return nullopt;
+}
+
+bool valid(uint8_t const* bitmap, size_t i)
+{
+    return bitmap == nullptr || ((bitmap[i / 8] >> (i % 8)) & 1) != 0;
+}
+
+// Validity of the child of a struct, which is null where the struct is
+vector<uint8_t> and_validity(ArrowArray const& batch, ArrowArray const& child)
+{
+    auto const* parent = static_cast<uint8_t const*>(batch.buffers[0]);
+    auto const* own = child.null_count == 0 ? nullptr : static_cast<uint8_t const*>(child.buffers[0]);
+    size_t const length = static_cast<size_t>(batch.length);
+    vector<uint8_t> bitmap((length + 7) / 8, 0);
+    for (size_t i = 0; i < length; i++)
+        if (valid(parent, batch.offset + i) && valid(own, child.offset + batch.offset + i))
+            bitmap[i / 8] |= uint8_t(1) << (i % 8);
+    return bitmap;
+}
+
+// offset is the one of the array, plus the one of its parent for children of a struct
+Column arrow_column(ArrowArray const& array, ArrowSchema const& schema, int64_t offset)
+{
+    if (schema.dictionary != nullptr)
+        throw runtime_error("dictionary encoded Arrow arrays are not supported");
+    auto [type, scale] = arrow_type(schema.format);
+    if (array.n_buffers != 2)
+        throw runtime_error("unexpected number of buffers in an Arrow array of format " + string(schema.format));
+    size_t const item = dtype_size(type);
+    auto const* data = static_cast<std::byte const*>(array.buffers[1]);
+    auto const* validity = array.null_count == 0 ? nullptr : static_cast<uint8_t const*>(array.buffers[0]);
+    return { data + offset * item, item, type, scale, validity, static_cast<size_t>(offset) };
+}
+
+bool has_nulls(ArrowArray const& array)
+{
+    return array.null_count != 0 && array.buffers[0] != nullptr;
+}
+
+ArrowArray const& child(ArrowArray const* batch, ArrowSchema const* schema, size_t i)
+{
+    check(batch, schema);
+    if (string_view(schema->format) != "+s")
+        throw runtime_error("Arrow array is not a struct");
+    if (i >= static_cast<size_t>(batch->n_children) || i >= static_cast<size_t>(schema->n_children))
+        throw runtime_error("Arrow struct has no child " + to_string(i));
+    return *batch->children[i];
+}
+
+size_t same_length(ArrowArray const& x, ArrowArray const& y)
+{
+    if (x.length != y.length)
+        throw runtime_error("x and y must have the same size");
+    return static_cast<size_t>(x.length);
+}
+}
+
+ArrowSource::ArrowSource(ArrowArray* x, ArrowSchema* x_schema, ArrowArray* y, ArrowSchema* y_schema, bool sorted_by_x)
+    : ColumnSource((check(x, x_schema), arrow_column(*x, *x_schema, x->offset)),
+                   (check(y, y_schema), arrow_column(*y, *y_schema, y->offset)),
+                   same_length(*x, *y),
+                   sorted_by_x && !has_nulls(*x))
+    , m_x(take(x))
+    , m_y(take(y))
+{
+    use_time_axis(x_schema->format);
+    release(*x_schema);
+    release(*y_schema);
+}
+
+ArrowSource::ArrowSource(ArrowArray* batch, ArrowSchema* schema, size_t x_child, size_t y_child, bool sorted_by_x)
+    : ColumnSource(arrow_column(child(batch, schema, x_child), *schema->children[x_child], child(batch, schema, x_child).offset + batch->offset),
+                   arrow_column(child(batch, schema, y_child), *schema->children[y_child], child(batch, schema, y_child).offset + batch->offset),
+                   static_cast<size_t>(batch->length),
+                   sorted_by_x && !has_nulls(child(batch, schema, x_child)) && !has_nulls(*batch))
+    , m_x(take(batch))
+    , m_y {}
+{
+    if (has_nulls(m_x))
+    {
+        m_x_validity = and_validity(m_x, *m_x.children[x_child]);
+        m_y_validity = and_validity(m_x, *m_x.children[y_child]);
+        ColumnSource::m_x.validity = m_x_validity.data();
+        ColumnSource::m_x.validity_offset = 0;
+        ColumnSource::m_y.validity = m_y_validity.data();
+        ColumnSource::m_y.validity_offset = 0;
+    }
+    use_time_axis(schema->children[x_child]->format);
+    release(*schema);
+}
+
+void ArrowSource::use_time_axis(char const* x_format)
+{
+    auto const units = epoch_units(x_format);
+    if (!units)
+        return;
+    // Values are read relative to an origin, any one close to them : the first valid value, as read in units
+    ColumnSource::m_x.scale = 1.;
+    size_t i = 0;
+    while (i < m_size && isnan(ColumnSource::m_x[i]))
+        i++;
+    int64_t const origin = i < m_size ? static_cast<int64_t>(clamp(ColumnSource::m_x[i], -9.2e18, 9.2e18)) : 0;
+    ColumnSource::m_x.origin = origin;
+    m_time_axis = TimeAxis { origin, *units };
+}
+
+ArrowSource::~ArrowSource()
+{
+    release(m_x);
+    release(m_y);
+}
+
+shared_ptr<ArrowSource> ArrowSource::make(ArrowArray* x, ArrowSchema* x_schema, ArrowArray* y, ArrowSchema* y_schema, bool sorted_by_x)
+{
+    return make_shared<ArrowSource>(x, x_schema, y, y_schema, sorted_by_x);
+}
+
+shared_ptr<ArrowSource> ArrowSource::make(ArrowArray* batch, ArrowSchema* schema, size_t x_child, size_t y_child, bool sorted_by_x)
+{
+    return make_shared<ArrowSource>(batch, schema, x_child, y_child, sorted_by_x);
+}
+}
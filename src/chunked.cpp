@@ -0,0 +1,372 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <plotter/chunked.hpp>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace plotter
+{
+
+using namespace std;
+
+namespace
+{
+// Chunked files are written and read in place : a big-endian machine could only read them by swapping every value
+void require_little_endian(string const& path)
+{
+    if (endian::native != endian::little)
+        throw runtime_error(path + " is little-endian, and this machine is not");
+}
+
+constexpr char magic[8] = { 'P', 'L', 'T', 'C', 'H', 'N', 'K', '1' };
+
+struct FileHeader
+{
+    char magic[8];
+    uint64_t chunk_size;
+    uint64_t summary_buckets;
+    uint64_t count;
+    uint64_t chunk_count;
+    uint64_t directory_offset;
+    Bounds bounds;
+};
+
+struct XY
+{
+    double x;
+    double y;
+};
+
+void read_at(int fd, void* data, size_t size, uint64_t offset, string const& path)
+{
+    auto* p = static_cast<char*>(data);
+    while (size > 0)
+    {
+        ssize_t n = pread(fd, p, size, offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            throw runtime_error("cannot read " + path);
+        p += n;
+        size -= n;
+        offset += n;
+    }
+}
+
+// First, lowest, highest and last points of [first, last), in the order of the points, without repetitions
+template <typename Emit>
+void extremes(Coordinate const* first, Coordinate const* last, Emit const& emit)
+{
+    Coordinate const* low = min_element(first, last, [](Coordinate const& a, Coordinate const& b) { return a.y < b.y; });
+    Coordinate const* high = max_element(first, last, [](Coordinate const& a, Coordinate const& b) { return a.y < b.y; });
+    Coordinate const* kept[] = { first, min(low, high), max(low, high), last - 1 };
+    for (size_t k = 0; k < 4; k++)
+        if (k == 0 || kept[k] != kept[k - 1])
+            emit(*kept[k]);
+}
+}
+
+ChunkedWriter::ChunkedWriter(string const& path, size_t chunk_size)
+    : m_path((require_little_endian(path), path))
+    , m_fd(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644))
+    , m_chunk_size(max<size_t>(chunk_size, 1))
+    , m_offset(sizeof(FileHeader))
+    , m_count(0)
+{
+    if (m_fd < 0)
+        throw runtime_error("cannot create " + path);
+    m_chunk.reserve(m_chunk_size);
+    FileHeader header {};
+    write(&header, sizeof(header)); // Filled by close()
+}
+
+ChunkedWriter::~ChunkedWriter()
+{
+    if (m_fd < 0)
+        return;
+    try
+    {
+        close();
+    }
+    catch (...)
+    {
+    }
+}
+
+void ChunkedWriter::append(double x, double y)
+{
+    if (m_fd < 0)
+        throw runtime_error(m_path + " is already closed");
+    if (!m_chunk.empty() ? x < m_chunk.back().x : (!m_directory.empty() && x < m_directory.back().last_x))
+        throw runtime_error(m_path + " : points must be appended sorted by x");
+    m_chunk.push_back({ x, y });
+    m_bounds.extend(x, y);
+    m_count++;
+    if (m_chunk.size() == m_chunk_size)
+        flush_chunk();
+}
+
+void ChunkedWriter::append(span<Coordinate const> points)
+{
+    for (auto const& c : points)
+        append(c.x, c.y);
+}
+
+void ChunkedWriter::close()
+{
+    if (m_fd < 0)
+        return;
+    flush_chunk();
+    FileHeader header;
+    memcpy(header.magic, magic, sizeof(magic));
+    header.chunk_size = m_chunk_size;
+    header.summary_buckets = summary_buckets;
+    header.count = m_count;
+    header.chunk_count = m_directory.size();
+    header.directory_offset = m_offset;
+    header.bounds = m_bounds;
+    write(m_directory.data(), m_directory.size() * sizeof(ChunkEntry));
+    bool const ok = lseek(m_fd, 0, SEEK_SET) == 0;
+    if (ok)
+        write(&header, sizeof(header));
+    int fd = m_fd;
+    m_fd = -1;
+    if (::close(fd) != 0 || !ok)
+        throw runtime_error("cannot write " + m_path);
+}
+
+void ChunkedWriter::write(void const* data, size_t size)
+{
+    auto const* p = static_cast<char const*>(data);
+    while (size > 0)
+    {
+        ssize_t n = ::write(m_fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            throw runtime_error("cannot write " + m_path);
+        p += n;
+        size -= n;
+    }
+}
+
+void ChunkedWriter::flush_chunk()
+{
+    if (m_chunk.empty())
+        return;
+    ChunkEntry e;
+    e.offset = m_offset;
+    e.count = m_chunk.size();
+    for (auto const& c : m_chunk)
+        e.bounds.extend(c.x, c.y);
+    e.first_x = m_chunk.front().x;
+    e.first_y = m_chunk.front().y;
+    e.last_x = m_chunk.back().x;
+    e.last_y = m_chunk.back().y;
+    auto by_y = [](Coordinate const& a, Coordinate const& b) { return a.y < b.y; };
+    e.x_of_y_min = min_element(m_chunk.begin(), m_chunk.end(), by_y)->x;
+    e.x_of_y_max = max_element(m_chunk.begin(), m_chunk.end(), by_y)->x;
+
+    vector<XY> data;
+    data.reserve(m_chunk.size());
+    for (auto const& c : m_chunk)
+        data.push_back({ c.x, c.y });
+    write(data.data(), data.size() * sizeof(XY));
+    data.clear();
+    size_t const n = m_chunk.size();
+    for (size_t b = 0; b < summary_buckets; b++)
+    {
+        size_t const first = b * n / summary_buckets;
+        size_t const last = (b + 1) * n / summary_buckets;
+        if (first < last)
+            extremes(m_chunk.data() + first, m_chunk.data() + last, [&](Coordinate const& c) { data.push_back({ c.x, c.y }); });
+    }
+    e.summary_offset = e.offset + e.count * sizeof(XY);
+    e.summary_count = data.size();
+    write(data.data(), data.size() * sizeof(XY));
+
+    m_offset = e.summary_offset + e.summary_count * sizeof(XY);
+    m_directory.push_back(e);
+    m_chunk.clear();
+}
+
+ChunkedSource::ChunkedSource(string const& path, size_t cache_bytes, pmr::memory_resource* resource)
+    : m_path((require_little_endian(path), path))
+    , m_fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC))
+    , m_resource(resource)
+    , m_chunks(resource)
+    , m_cache_bytes(cache_bytes)
+    , m_cached_bytes(0)
+{
+    if (m_fd < 0)
+        throw runtime_error("cannot open " + path);
+    try
+    {
+        FileHeader header;
+        read_at(m_fd, &header, sizeof(header), 0, path);
+        if (memcmp(header.magic, magic, sizeof(magic)) != 0)
+            throw runtime_error(path + " is not a chunked file");
+        m_size = header.count;
+        m_summary_buckets = header.summary_buckets;
+        m_bounds = header.bounds;
+        // A corrupt or truncated file must not make us allocate or read beyond it
+        struct stat st;
+        if (fstat(m_fd, &st) != 0)
+            throw runtime_error("cannot stat " + path);
+        uint64_t const file_size = st.st_size;
+        auto const fits = [file_size](uint64_t offset, uint64_t count, uint64_t item_size) {
+            return offset <= file_size && count <= (file_size - offset) / item_size;
+        };
+        if (!fits(header.directory_offset, header.chunk_count, sizeof(ChunkEntry)))
+            throw runtime_error(path + " is truncated or corrupt");
+        m_chunks.resize(header.chunk_count);
+        read_at(m_fd, m_chunks.data(), m_chunks.size() * sizeof(ChunkEntry), header.directory_offset, path);
+        for (auto const& e : m_chunks)
+            if (!fits(e.offset, e.count, sizeof(XY)) || !fits(e.summary_offset, e.summary_count, sizeof(XY)))
+                throw runtime_error(path + " is truncated or corrupt");
+    }
+    catch (...)
+    {
+        ::close(m_fd);
+        throw;
+    }
+}
+
+ChunkedSource::~ChunkedSource()
+{
+    ::close(m_fd);
+}
+
+shared_ptr<ChunkedSource> ChunkedSource::open(string const& path, size_t cache_bytes, pmr::memory_resource* resource)
+{
+    return allocate_shared<ChunkedSource>(pmr::polymorphic_allocator<ChunkedSource>(resource), path, cache_bytes, resource);
+}
+
+size_t ChunkedSource::cached_bytes() const
+{
+    lock_guard lock(m_cache_mutex);
+    return m_cached_bytes;
+}
+
+shared_ptr<ChunkedSource::Page const> ChunkedSource::page(size_t chunk, bool summary) const
+{
+    size_t const key = 2 * chunk + summary;
+    {
+        lock_guard lock(m_cache_mutex);
+        if (auto it = m_cached.find(key); it != m_cached.end())
+        {
+            m_lru.splice(m_lru.begin(), m_lru, it->second);
+            return it->second->second;
+        }
+    }
+
+    // Read without the lock, so that other threads can use the cache meanwhile. As they may be prefetch workers, pages
+    // come from the global heap : the caller's resource may not be synchronized, and could not reuse evicted pages.
+    ChunkEntry const& e = m_chunks[chunk];
+    size_t const count = summary ? e.summary_count : e.count;
+    pmr::vector<XY> data(count, pmr::new_delete_resource());
+    read_at(m_fd, data.data(), count * sizeof(XY), summary ? e.summary_offset : e.offset, m_path);
+    auto p = allocate_shared<Page>(pmr::polymorphic_allocator<Page>(pmr::new_delete_resource())); // The page uses the same resource
+    p->reserve(count);
+    for (auto const& xy : data)
+        p->push_back({ xy.x, xy.y });
+
+    lock_guard lock(m_cache_mutex);
+    if (auto it = m_cached.find(key); it != m_cached.end())
+        return it->second->second; // Read by another thread meanwhile
+    m_lru.emplace_front(key, p);
+    m_cached.emplace(key, m_lru.begin());
+    m_cached_bytes += count * sizeof(Coordinate);
+    // Pages still used by a caller stay alive until it is done with them
+    while (m_cached_bytes > m_cache_bytes && m_lru.size() > 1)
+    {
+        auto& [k, evicted] = m_lru.back();
+        m_cached_bytes -= evicted->size() * sizeof(Coordinate);
+        m_cached.erase(k);
+        m_lru.pop_back();
+    }
+    return p;
+}
+
+span<Coordinate const> ChunkedSource::visible(View const& view, pmr::vector<Coordinate>& scratch) const
+{
+    scratch.clear();
+    auto first = lower_bound(m_chunks.begin(), m_chunks.end(), view.x_min, [](ChunkEntry const& e, double x) { return e.bounds.x_max < x; });
+    auto last = upper_bound(first, m_chunks.end(), view.x_max, [](double x, ChunkEntry const& e) { return x < e.bounds.x_min; });
+
+    // The borders only need the closest point of each neighbour
+    if (first != m_chunks.begin())
+        scratch.push_back({ prev(first)->last_x, prev(first)->last_y });
+
+    // Reading every point of a wide view would not fit in the cache : markers are decimated too then
+    size_t count = 0;
+    for (auto e = first; e != last; ++e)
+        count += e->count;
+    bool const decimating = view.decimate || count * sizeof(Coordinate) > m_cache_bytes;
+
+    double const column_width = (view.x_max - view.x_min) / max<size_t>(view.columns, 1);
+    for (auto e = first; e != last; ++e)
+    {
+        double const width = (e->bounds.x_max - e->bounds.x_min) / column_width; // In columns
+        if (decimating && width < 1)
+        {
+            // The chunk is narrower than a column : its entry has everything decimation would keep
+            bool const min_first = e->x_of_y_min <= e->x_of_y_max;
+            scratch.push_back({ e->first_x, e->first_y });
+            scratch.push_back({ min_first ? e->x_of_y_min : e->x_of_y_max, min_first ? e->bounds.y_min : e->bounds.y_max });
+            scratch.push_back({ min_first ? e->x_of_y_max : e->x_of_y_min, min_first ? e->bounds.y_max : e->bounds.y_min });
+            scratch.push_back({ e->last_x, e->last_y });
+        }
+        else if (decimating && width < m_summary_buckets)
+        {
+            auto summary = page(e - m_chunks.begin(), true);
+            scratch.insert(scratch.end(), summary->begin(), summary->end());
+        }
+        else
+        {
+            auto points = page(e - m_chunks.begin(), false);
+            auto from = lower_bound(points->begin(), points->end(), view.x_min, [](Coordinate const& c, double x) { return c.x < x; });
+            auto to = upper_bound(from, points->end(), view.x_max, [](double x, Coordinate const& c) { return x < c.x; });
+            if (from != points->begin())
+                --from;
+            if (to != points->end())
+                ++to;
+            size_t const start = scratch.size();
+            scratch.insert(scratch.end(), from, to);
+            // Decimating each chunk as it comes bounds the scratch memory
+            span<Coordinate> added { scratch.begin() + start, scratch.end() };
+            if (decimating && added.size() > view.columns * decimation_points_per_column)
+                scratch.resize(start + decimate(added, view));
+        }
+    }
+
+    if (last != m_chunks.end())
+        scratch.push_back({ last->first_x, last->first_y });
+    // Entries and summaries of neighbouring chunks can still share columns
+    if (decimating && scratch.size() > view.columns * decimation_points_per_column)
+        scratch.resize(decimate(scratch, view));
+    return scratch;
+}
+}
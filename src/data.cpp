@@ -0,0 +1,505 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <plotter/data.hpp>
+#include <stdexcept>
+
+namespace plotter
+{
+
+using namespace std;
+
+namespace
+{
+// Bit streams used by CompressedSource. Bits are stored from the most significant one.
+class BitWriter
+{
+public:
+    BitWriter(pmr::vector<uint64_t>& words)
+        : m_words(words)
+        , m_size(words.size() * 64)
+    { }
+    size_t size() const { return m_size; }
+    void write(uint64_t value, unsigned n) // Writes the n lowest bits of value
+    {
+        while (n > 0)
+        {
+            size_t const offset = m_size % 64;
+            if (offset == 0)
+                m_words.push_back(0);
+            unsigned const available = 64 - offset;
+            unsigned const taken = min(n, available);
+            uint64_t chunk = value >> (n - taken);
+            if (taken < 64)
+                chunk &= (uint64_t(1) << taken) - 1;
+            m_words.back() |= chunk << (available - taken);
+            m_size += taken;
+            n -= taken;
+        }
+    }
+
+private:
+    pmr::vector<uint64_t>& m_words;
+    size_t m_size;
+};
+
+class BitReader
+{
+public:
+    BitReader(uint64_t const* words, size_t position)
+        : m_words(words)
+        , m_position(position)
+    { }
+    uint64_t read(unsigned n)
+    {
+        uint64_t r = 0;
+        while (n > 0)
+        {
+            size_t const offset = m_position % 64;
+            unsigned const available = 64 - offset;
+            unsigned const taken = min(n, available);
+            uint64_t const chunk = (m_words[m_position / 64] << offset) >> (64 - taken);
+            r = (taken == 64) ? chunk : (r << taken) | chunk;
+            m_position += taken;
+            n -= taken;
+        }
+        return r;
+    }
+    bool bit() { return read(1) != 0; }
+
+private:
+    uint64_t const* m_words;
+    size_t m_position;
+};
+
+uint64_t to_bits(double d)
+{
+    return bit_cast<uint64_t>(d);
+}
+
+double from_bits(uint64_t b)
+{
+    return bit_cast<double>(b);
+}
+}
+
+void Bounds::extend(double x, double y)
+{
+    x_min = min(x_min, x);
+    x_max = max(x_max, x);
+    y_min = min(y_min, y);
+    y_max = max(y_max, y);
+}
+
+void Bounds::extend(Bounds const& b)
+{
+    x_min = min(x_min, b.x_min);
+    x_max = max(x_max, b.x_max);
+    y_min = min(y_min, b.y_min);
+    y_max = max(y_max, b.y_max);
+}
+
+namespace
+{
+mutex new_data_mutex;
+function<void()> new_data_handler; // Set while a render loop runs
+atomic<bool> new_data_notified { false };
+}
+
+void notify_new_data()
+{
+    if (new_data_notified.load(memory_order_acquire) || new_data_notified.exchange(true, memory_order_acq_rel))
+        return; // Not taken yet : the render loop has not updated the sources since
+    lock_guard lock(new_data_mutex);
+    if (new_data_handler)
+        new_data_handler();
+}
+
+void set_new_data_handler(function<void()> handler)
+{
+    lock_guard lock(new_data_mutex);
+    new_data_handler = move(handler);
+    new_data_notified.store(false, memory_order_release);
+}
+
+void take_new_data_notification()
+{
+    new_data_notified.store(false, memory_order_release);
+}
+
+size_t decimate(span<Coordinate> points, View const& view)
+{
+    double const column_width = (view.x_max - view.x_min) / view.columns;
+    if (view.columns == 0 || !(column_width > 0.))
+        return points.size();
+    auto column = [&](double x) { return floor((x - view.x_min) / column_width); };
+    size_t kept = 0;
+    size_t i = 0;
+    while (i < points.size())
+    {
+        double const c = column(points[i].x);
+        size_t i_min = i;
+        size_t i_max = i;
+        size_t j = i + 1;
+        for (; j < points.size() && column(points[j].x) == c; j++)
+        {
+            if (points[j].y < points[i_min].y)
+                i_min = j;
+            if (points[j].y > points[i_max].y)
+                i_max = j;
+        }
+        array<size_t, 4> indices { i, min(i_min, i_max), max(i_min, i_max), j - 1 };
+        array<Coordinate, 4> selected;
+        size_t n = 0;
+        for (size_t k = 0; k < indices.size(); k++)
+        {
+            if (k == 0 || indices[k] != indices[k - 1])
+                selected[n++] = points[indices[k]]; // Read everything before writing, as kept <= i
+        }
+        for (size_t k = 0; k < n; k++)
+            points[kept++] = selected[k];
+        i = j;
+    }
+    return kept;
+}
+
+void MinMaxPyramid::assign(span<span<Tile const> const> levels)
+{
+    m_storage.clear();
+    m_levels.assign(levels.begin(), levels.end());
+}
+
+Dataset::Dataset(pmr::vector<Coordinate> points)
+    : m_points(move(points))
+    , m_sorted_by_x(true)
+    , m_pyramid(m_points.get_allocator().resource())
+{
+    for (size_t i = 0; i < m_points.size(); i++)
+    {
+        m_bounds.extend(m_points[i].x, m_points[i].y);
+        if (i > 0 && m_points[i].x < m_points[i - 1].x)
+            m_sorted_by_x = false;
+    }
+    // Here rather than on first use, which would be while a frame is drawn
+    if (m_sorted_by_x)
+        m_pyramid.build(m_points.size(), [this](size_t i) { return m_points[i].y; });
+}
+
+Dataset::Dataset(span<Coordinate const> points, pmr::memory_resource* resource)
+    : Dataset(pmr::vector<Coordinate>(points.begin(), points.end(), resource))
+{ }
+
+shared_ptr<Dataset> Dataset::make(pmr::vector<Coordinate> points)
+{
+    pmr::polymorphic_allocator<Dataset> allocator { points.get_allocator().resource() };
+    return allocate_shared<Dataset>(allocator, move(points));
+}
+
+shared_ptr<Dataset> Dataset::make(span<Coordinate const> points, pmr::memory_resource* resource)
+{
+    return make(pmr::vector<Coordinate>(points.begin(), points.end(), resource));
+}
+
+span<Coordinate const> Dataset::visible(View const& view, pmr::vector<Coordinate>& scratch) const
+{
+    if (!m_sorted_by_x)
+        return m_points;
+    return visible_sorted(m_points, view, scratch, [this]() -> MinMaxPyramid const& { return m_pyramid; });
+}
+
+GeneratedSource::GeneratedSource(size_t size, Generator generator, optional<Bounds> bounds)
+    : m_size(size)
+    , m_generator(move(generator))
+{
+    if (bounds)
+    {
+        m_bounds = *bounds;
+        call_once(m_bounds_computed, []() { });
+    }
+}
+
+shared_ptr<GeneratedSource> GeneratedSource::sample(function<double(double)> f, double x_first, double step, size_t size, optional<Bounds> bounds)
+{
+    return make_shared<GeneratedSource>(size, [f = move(f), x_first, step](size_t i) { double x = x_first + i * step; return Coordinate { x, f(x) }; }, bounds);
+}
+
+Bounds GeneratedSource::bounds() const
+{
+    call_once(m_bounds_computed, [this]() {
+        for (size_t i = 0; i < m_size; i++)
+        {
+            Coordinate c = m_generator(i);
+            m_bounds.extend(c.x, c.y);
+        }
+    });
+    return m_bounds;
+}
+
+span<Coordinate const> GeneratedSource::visible(View const& view, pmr::vector<Coordinate>& scratch) const
+{
+    scratch.clear();
+    if (m_size == 0)
+        return scratch;
+    // Binary searches on the index, which only evaluate O(log(size)) points
+    auto first_after = [this](double x, bool strict) {
+        size_t lo = 0;
+        size_t hi = m_size;
+        while (lo < hi)
+        {
+            size_t mid = lo + (hi - lo) / 2;
+            double v = m_generator(mid).x;
+            if (strict ? v <= x : v < x)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo;
+    };
+    size_t first = first_after(view.x_min, false);
+    size_t last = first_after(view.x_max, true);
+    if (first > 0)
+        first--;
+    if (last < m_size)
+        last++;
+
+    size_t const count = last - first;
+    size_t const budget = max<size_t>(view.columns * decimation_points_per_column, 2);
+    if (!view.decimate || count <= budget)
+    {
+        scratch.reserve(count);
+        for (size_t i = first; i < last; i++)
+            scratch.push_back(m_generator(i));
+        return scratch;
+    }
+    // Too dense : sample evenly, like functions are, but always keep the points on the borders
+    scratch.reserve(budget + 1);
+    for (size_t k = 0; k < budget; k++)
+        scratch.push_back(m_generator(first + k * (count - 1) / (budget - 1)));
+    return scratch;
+}
+
+CompressedSource::CompressedSource(span<Coordinate const> points, pmr::memory_resource* resource)
+    : m_blocks(resource)
+    , m_bits(resource)
+    , m_size(points.size())
+    , m_sorted_by_x(true)
+{
+    BitWriter writer { m_bits };
+    for (size_t start = 0; start < points.size(); start += block_size)
+    {
+        size_t const end = min(start + block_size, points.size());
+        Block b { writer.size(), static_cast<uint32_t>(end - start), {}, points[start], points[end - 1], points[start].x, points[start].x };
+        b.first.x_error = b.first.y_error = b.last.x_error = b.last.y_error = 0.;
+        int64_t previous_delta = 0;
+        unsigned previous_leading = 65; // No window yet
+        unsigned previous_trailing = 0;
+        for (size_t i = start; i < end; i++)
+        {
+            Coordinate const& c = points[i];
+            if (c.x_error != 0. || c.y_error != 0.)
+                throw runtime_error("compressed sources do not store uncertainties");
+            if (c.y < b.bounds.y_min)
+                b.x_of_y_min = c.x;
+            if (c.y > b.bounds.y_max)
+                b.x_of_y_max = c.x;
+            b.bounds.extend(c.x, c.y);
+            if (i > 0 && c.x < points[i - 1].x)
+                m_sorted_by_x = false;
+            if (i == start)
+                continue;
+
+            // x : delta-of-delta
+            int64_t const delta = static_cast<int64_t>(to_bits(c.x) - to_bits(points[i - 1].x));
+            uint64_t const dod = static_cast<uint64_t>(delta) - static_cast<uint64_t>(previous_delta);
+            int64_t const signed_dod = static_cast<int64_t>(dod);
+            previous_delta = delta;
+            if (dod == 0)
+                writer.write(0b0, 1);
+            else if (signed_dod >= -63 && signed_dod <= 64)
+            {
+                writer.write(0b10, 2);
+                writer.write(signed_dod + 63, 7);
+            }
+            else if (signed_dod >= -255 && signed_dod <= 256)
+            {
+                writer.write(0b110, 3);
+                writer.write(signed_dod + 255, 9);
+            }
+            else if (signed_dod >= -2047 && signed_dod <= 2048)
+            {
+                writer.write(0b1110, 4);
+                writer.write(signed_dod + 2047, 12);
+            }
+            else
+            {
+                writer.write(0b1111, 4);
+                writer.write(dod, 64);
+            }
+
+            // y : XOR with the previous value
+            uint64_t const x_or = to_bits(c.y) ^ to_bits(points[i - 1].y);
+            if (x_or == 0)
+            {
+                writer.write(0b0, 1);
+                continue;
+            }
+            writer.write(0b1, 1);
+            unsigned const leading = min(countl_zero(x_or), 31);
+            unsigned const trailing = countr_zero(x_or);
+            if (previous_leading != 65 && leading >= previous_leading && trailing >= previous_trailing)
+            {
+                writer.write(0b0, 1);
+                writer.write(x_or >> previous_trailing, 64 - previous_leading - previous_trailing);
+            }
+            else
+            {
+                unsigned const length = 64 - leading - trailing;
+                writer.write(0b1, 1);
+                writer.write(leading, 5);
+                writer.write(length - 1, 6);
+                writer.write(x_or >> trailing, length);
+                previous_leading = leading;
+                previous_trailing = trailing;
+            }
+        }
+        m_bounds.extend(b.bounds);
+        m_blocks.push_back(b);
+    }
+    m_bits.shrink_to_fit();
+}
+
+shared_ptr<CompressedSource> CompressedSource::make(span<Coordinate const> points, pmr::memory_resource* resource)
+{
+    return allocate_shared<CompressedSource>(pmr::polymorphic_allocator<CompressedSource> { resource }, points, resource);
+}
+
+shared_ptr<CompressedSource> CompressedSource::make(vector<double> const& x, vector<double> const& y, pmr::memory_resource* resource)
+{
+    if (x.size() != y.size())
+    {
+        throw runtime_error("x and y must have the same size");
+    }
+    pmr::vector<Coordinate> points(resource);
+    points.reserve(x.size());
+    for (size_t i = 0; i < x.size(); i++)
+    {
+        points.push_back({ x[i], y[i] });
+    }
+    return make(points, resource);
+}
+
+size_t CompressedSource::memory() const
+{
+    return sizeof(*this) + m_blocks.capacity() * sizeof(Block) + m_bits.capacity() * sizeof(uint64_t);
+}
+
+void CompressedSource::decode(Block const& b, pmr::vector<Coordinate>& into) const
+{
+    BitReader reader { m_bits.data(), b.bit_offset };
+    uint64_t x = to_bits(b.first.x);
+    uint64_t y = to_bits(b.first.y);
+    uint64_t delta = 0;
+    unsigned leading = 0;
+    unsigned trailing = 0;
+    into.push_back({ b.first.x, b.first.y });
+    for (uint32_t i = 1; i < b.count; i++)
+    {
+        uint64_t dod = 0;
+        if (reader.bit())
+        {
+            if (!reader.bit())
+                dod = reader.read(7) - 63;
+            else if (!reader.bit())
+                dod = reader.read(9) - 255;
+            else if (!reader.bit())
+                dod = reader.read(12) - 2047;
+            else
+                dod = reader.read(64);
+        }
+        delta += dod;
+        x += delta;
+
+        if (reader.bit())
+        {
+            if (reader.bit())
+            {
+                leading = reader.read(5);
+                unsigned const length = reader.read(6) + 1;
+                trailing = 64 - leading - length;
+            }
+            y ^= reader.read(64 - leading - trailing) << trailing;
+        }
+        into.push_back({ from_bits(x), from_bits(y) });
+    }
+}
+
+span<Coordinate const> CompressedSource::visible(View const& view, pmr::vector<Coordinate>& scratch) const
+{
+    scratch.clear();
+    if (!m_sorted_by_x)
+    {
+        // Every block is needed to connect the points in the right order
+        scratch.reserve(m_size);
+        for (auto const& b : m_blocks)
+            decode(b, scratch);
+        return scratch;
+    }
+
+    // Blocks are sorted too : keep the ones that intersect the view, and one more on each side for the borders
+    auto first = lower_bound(m_blocks.begin(), m_blocks.end(), view.x_min, [](Block const& b, double x) { return b.bounds.x_max < x; });
+    auto last = upper_bound(first, m_blocks.end(), view.x_max, [](double x, Block const& b) { return x < b.bounds.x_min; });
+    if (first != m_blocks.begin())
+        --first;
+    if (last != m_blocks.end())
+        ++last;
+
+    double const column_width = (view.x_max - view.x_min) / max<size_t>(view.columns, 1);
+    for (auto b = first; b != last; ++b)
+    {
+        if (view.decimate && b->bounds.x_max - b->bounds.x_min < column_width)
+        {
+            // The block is narrower than a column : its header has everything decimation would keep
+            bool const min_first = b->x_of_y_min <= b->x_of_y_max;
+            scratch.push_back(b->first);
+            scratch.push_back({ min_first ? b->x_of_y_min : b->x_of_y_max, min_first ? b->bounds.y_min : b->bounds.y_max });
+            scratch.push_back({ min_first ? b->x_of_y_max : b->x_of_y_min, min_first ? b->bounds.y_max : b->bounds.y_min });
+            scratch.push_back(b->last);
+        }
+        else
+            decode(*b, scratch);
+    }
+
+    // Trim the decoded blocks to the view and its two neighbours
+    auto first_point = lower_bound(scratch.begin(), scratch.end(), view.x_min, [](Coordinate const& c, double x) { return c.x < x; });
+    auto last_point = upper_bound(first_point, scratch.end(), view.x_max, [](double x, Coordinate const& c) { return x < c.x; });
+    if (first_point != scratch.begin())
+        --first_point;
+    if (last_point != scratch.end())
+        ++last_point;
+    span<Coordinate> points { first_point, last_point };
+    if (view.decimate && points.size() > view.columns * decimation_points_per_column)
+        points = points.first(decimate(points, view));
+    return points;
+}
+}
@@ -0,0 +1,617 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <exception>
+#include <fcntl.h>
+#include <plotter/io.hpp>
+#include <stdexcept>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace plotter
+{
+
+using namespace std;
+
+namespace
+{
+// Raw and .npy files are read in place : a big-endian machine could only read them by swapping every value
+void require_little_endian(string const& path)
+{
+    if (endian::native != endian::little)
+        throw runtime_error(path + " is little-endian, and this machine is not");
+}
+
+struct NpyArray
+{
+    DType type;
+    bool fortran_order;
+    size_t rows;
+    size_t columns; // 1 for a 1-D array
+    size_t data_offset;
+};
+
+// Finds the value of 'key' in the header dictionary of a .npy file
+string_view npy_field(string_view header, string_view key, string const& path)
+{
+    size_t k = header.find("'" + string(key) + "'");
+    if (k == string_view::npos)
+        throw runtime_error(path + " : no " + string(key) + " in the .npy header");
+    size_t const colon = header.find(':', k);
+    size_t const start = colon == string_view::npos ? colon : header.find_first_not_of(" ", colon + 1);
+    if (start == string_view::npos)
+        throw runtime_error(path + " : no value for " + string(key) + " in the .npy header");
+    size_t end = header[start] == '(' ? header.find(')', start) : header.find_first_of(",}", start);
+    if (end == string_view::npos)
+        throw runtime_error(path + " : unterminated " + string(key) + " in the .npy header");
+    if (header[start] == '(')
+        end++;
+    return header.substr(start, end - start);
+}
+
+NpyArray parse_npy(MappedFile const& file, string const& path)
+{
+    auto const* bytes = reinterpret_cast<unsigned char const*>(file.data());
+    if (file.size() < 10 || string_view(reinterpret_cast<char const*>(bytes), 6) != "\x93NUMPY")
+        throw runtime_error(path + " is not a .npy file");
+    unsigned const major = bytes[6];
+    size_t header_length;
+    size_t header_start;
+    if (major == 1)
+    {
+        header_length = bytes[8] | (bytes[9] << 8);
+        header_start = 10;
+    }
+    else
+    {
+        if (file.size() < 12)
+            throw runtime_error(path + " is not a .npy file");
+        header_length = bytes[8] | (bytes[9] << 8) | (bytes[10] << 16) | (size_t(bytes[11]) << 24);
+        header_start = 12;
+    }
+    if (header_start + header_length > file.size())
+        throw runtime_error(path + " : truncated .npy header");
+    string_view header(reinterpret_cast<char const*>(bytes) + header_start, header_length);
+
+    NpyArray a;
+    string_view descr = npy_field(header, "descr", path);
+    if (descr == "'<f8'" || descr == "'=f8'")
+        a.type = DType::Float64;
+    else if (descr == "'<f4'" || descr == "'=f4'")
+        a.type = DType::Float32;
+    else
+        throw runtime_error(path + " : unsupported .npy dtype " + string(descr) + ", only little-endian float32 and float64 are");
+    a.fortran_order = npy_field(header, "fortran_order", path) == "True";
+
+    string_view shape = npy_field(header, "shape", path); // "(rows,)" or "(rows, columns)"
+    vector<size_t> dimensions;
+    for (size_t i = shape.find_first_of("0123456789"); i != string_view::npos; i = shape.find_first_of("0123456789", i))
+    {
+        size_t end = shape.find_first_not_of("0123456789", i);
+        string_view const digits = shape.substr(i, end - i);
+        size_t d;
+        if (from_chars(digits.data(), digits.data() + digits.size(), d).ec != errc())
+            throw runtime_error(path + " : invalid .npy shape " + string(shape));
+        dimensions.push_back(d);
+        i = end;
+    }
+    if (dimensions.empty() || dimensions.size() > 2)
+        throw runtime_error(path + " : only 1-D and 2-D .npy arrays are supported");
+    a.rows = dimensions[0];
+    a.columns = dimensions.size() == 2 ? dimensions[1] : 1;
+    a.data_offset = header_start + header_length;
+    size_t data_bytes;
+    if (__builtin_mul_overflow(a.rows, a.columns, &data_bytes) || __builtin_mul_overflow(data_bytes, dtype_size(a.type), &data_bytes) || data_bytes > file.size() - a.data_offset)
+        throw runtime_error(path + " : truncated .npy data");
+    return a;
+}
+
+Column npy_column(MappedFile const& file, NpyArray const& a, size_t column, string const& path)
+{
+    if (column >= a.columns)
+        throw runtime_error(path + " has no column " + to_string(column));
+    size_t const item = dtype_size(a.type);
+    if (a.fortran_order)
+        return { file.data() + a.data_offset + column * a.rows * item, item, a.type };
+    return { file.data() + a.data_offset + column * item, a.columns * item, a.type };
+}
+
+// Number of values of a raw column in a file of `file_size` bytes
+size_t raw_count(ColumnLayout const& l, size_t file_size)
+{
+    size_t const item = dtype_size(l.type);
+    size_t const stride = l.stride == 0 ? item : l.stride;
+    if (l.offset + item > file_size)
+        return 0;
+    return (file_size - l.offset - item) / stride + 1;
+}
+
+Column raw_column(MappedFile const& file, ColumnLayout const& l)
+{
+    return { file.data() + l.offset, l.stride == 0 ? dtype_size(l.type) : l.stride, l.type };
+}
+
+bool is_blank(char const* begin, char const* end)
+{
+    return all_of(begin, end, [](char c) { return c == ' ' || c == '\r' || c == '\t'; });
+}
+
+bool parse_number(char const* begin, char const* end, double& value)
+{
+    while (begin < end && (*begin == ' ' || *begin == '\t'))
+        begin++;
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+        end--;
+    if (begin < end && *begin == '+')
+        begin++; // from_chars does not accept it
+    auto result = from_chars(begin, end, value);
+    return result.ec == errc() && result.ptr == end;
+}
+
+char const* next_line(char const* p, char const* end)
+{
+    char const* newline = static_cast<char const*>(memchr(p, '\n', end - p));
+    return newline == nullptr ? end : newline + 1;
+}
+}
+
+size_t dtype_size(DType t)
+{
+    switch (t)
+    {
+    case DType::Int8:
+    case DType::UInt8:
+        return 1;
+    case DType::Int16:
+    case DType::UInt16:
+        return 2;
+    case DType::Float32:
+    case DType::Int32:
+    case DType::UInt32:
+        return 4;
+    case DType::Float64:
+    case DType::Int64:
+    case DType::UInt64:
+        return 8;
+    }
+    return 8;
+}
+
+MappedFile::MappedFile(string const& path)
+    : m_data(nullptr)
+    , m_size(0)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw runtime_error("cannot open " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        throw runtime_error("cannot stat " + path);
+    }
+    m_size = st.st_size;
+    if (m_size > 0)
+    {
+        void* p = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            ::close(fd);
+            throw runtime_error("cannot map " + path);
+        }
+        m_data = static_cast<std::byte const*>(p);
+    }
+    ::close(fd); // The mapping keeps the file alive
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data != nullptr)
+        munmap(const_cast<std::byte*>(m_data), m_size);
+}
+
+ColumnSource::ColumnSource(Column x, Column y, size_t size, bool sorted_by_x)
+    : m_x(x)
+    , m_y(y)
+    , m_size(size)
+    , m_sorted_by_x(sorted_by_x)
+{ }
+
+Bounds ColumnSource::bounds() const
+{
+    call_once(m_bounds_computed, [this]() {
+        if (m_size == 0)
+            return;
+        if (!m_sorted_by_x || m_size <= bounds_sample_size)
+        {
+            for (size_t i = 0; i < m_size; i++)
+                m_bounds.extend(m_x[i], m_y[i]);
+            return;
+        }
+        // Reading every y would read the whole file : a sample is enough to choose what to display first
+        m_bounds.extend(m_x[0], m_y[0]);
+        m_bounds.extend(m_x[m_size - 1], m_y[m_size - 1]);
+        for (size_t k = 1; k + 1 < bounds_sample_size; k++)
+        {
+            size_t i = k * (m_size - 1) / (bounds_sample_size - 1);
+            m_bounds.extend(m_x[i], m_y[i]);
+        }
+    });
+    return m_bounds;
+}
+
+span<Coordinate const> ColumnSource::visible(View const& view, pmr::vector<Coordinate>& scratch) const
+{
+    scratch.clear();
+    // Timestamps are read relative to the origin of the view, with integer arithmetic
+    Column x_column = m_x;
+    if (m_time_axis)
+        x_column.origin = view.x_origin;
+    size_t first = 0;
+    size_t last = m_size;
+    if (m_sorted_by_x)
+    {
+        // Binary searches only read O(log(size)) pages
+        size_t lo = 0;
+        size_t hi = m_size;
+        while (lo < hi)
+        {
+            size_t mid = lo + (hi - lo) / 2;
+            if (x_column[mid] < view.x_min)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        first = lo;
+        hi = m_size;
+        while (lo < hi)
+        {
+            size_t mid = lo + (hi - lo) / 2;
+            if (x_column[mid] <= view.x_max)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        last = lo;
+        if (first > 0)
+            first--;
+        if (last < m_size)
+            last++;
+    }
+
+    size_t const count = last - first;
+    if (!m_sorted_by_x || !view.decimate || count <= view.columns * decimation_points_per_column)
+    {
+        scratch.reserve(count);
+        for (size_t i = first; i < last; i++)
+            scratch.push_back({ x_column[i], m_y[i] });
+        return scratch;
+    }
+    if (count > view.columns * MinMaxPyramid::base_block)
+    {
+        // Scanning would read the whole range : only the extremes of the blocks of the index are read, and a gap is kept
+        // where blocks with missing values were skipped
+        constexpr size_t block = MinMaxPyramid::base_block;
+        size_t previous = first;
+        pyramid().select(first, last, view.columns, [this](size_t i) { return m_y[i]; }, [&](size_t i) {
+            if (m_gap_blocks[i / block + 1] != m_gap_blocks[previous / block + 1] && !scratch.empty() && !isnan(scratch.back().y))
+                scratch.push_back({ x_column[i], numeric_limits<double>::quiet_NaN() });
+            scratch.push_back({ x_column[i], m_y[i] });
+            previous = i;
+        });
+        return scratch;
+    }
+
+    // Decimate while reading, so that only about four points per column are copied
+    double const column_width = (view.x_max - view.x_min) / max<size_t>(view.columns, 1);
+    scratch.reserve(4 * (view.columns + 2));
+    size_t i = first;
+    while (i < last)
+    {
+        Coordinate const start { x_column[i], m_y[i] };
+        if (isnan(start.x) || isnan(start.y))
+        {
+            // Gaps are kept, once, so that lines are broken there
+            if (scratch.empty() || !isnan(scratch.back().y))
+                scratch.push_back({ start.x, numeric_limits<double>::quiet_NaN() });
+            i++;
+            continue;
+        }
+        double const c = floor((start.x - view.x_min) / column_width);
+        Coordinate low = start;
+        Coordinate high = start;
+        Coordinate end = start;
+        size_t i_low = i;
+        size_t i_high = i;
+        size_t j = i + 1;
+        for (; j < last; j++)
+        {
+            double const x = x_column[j];
+            if (floor((x - view.x_min) / column_width) != c)
+                break;
+            double const y = m_y[j];
+            if (isnan(y))
+                break;
+            end = { x, y };
+            if (y < low.y)
+            {
+                low = end;
+                i_low = j;
+            }
+            if (y > high.y)
+            {
+                high = end;
+                i_high = j;
+            }
+        }
+        scratch.push_back(start);
+        Coordinate const& a = i_low <= i_high ? low : high;
+        Coordinate const& b = i_low <= i_high ? high : low;
+        size_t const i_a = min(i_low, i_high);
+        size_t const i_b = max(i_low, i_high);
+        if (i_a != i)
+            scratch.push_back(a);
+        if (i_b != i_a)
+            scratch.push_back(b);
+        if (j - 1 != i_b)
+            scratch.push_back(end);
+        i = j;
+    }
+    return scratch;
+}
+
+MinMaxPyramid const& ColumnSource::pyramid() const
+{
+    call_once(m_pyramid_built, [this]() {
+        if (!m_sorted_by_x)
+            return;
+        m_pyramid.build(m_size, [this](size_t i) { return m_y[i]; });
+        constexpr size_t block = MinMaxPyramid::base_block;
+        m_gap_blocks.reserve(m_size / block + 2);
+        m_gap_blocks.push_back(0);
+        for (size_t start = 0; start < m_size; start += block)
+        {
+            bool gap = false;
+            for (size_t i = start; i < min(start + block, m_size) && !gap; i++)
+                gap = isnan(m_y[i]);
+            m_gap_blocks.push_back(m_gap_blocks.back() + gap);
+        }
+    });
+    return m_pyramid;
+}
+
+MappedSource::MappedSource(shared_ptr<MappedFile> x_file, Column x, size_t x_size, shared_ptr<MappedFile> y_file, Column y, size_t y_size, bool sorted_by_x)
+    : ColumnSource(x, y, min(x_size, y_size), sorted_by_x)
+    , m_x_file(move(x_file))
+    , m_y_file(move(y_file))
+{ }
+
+shared_ptr<MappedSource> MappedSource::open_raw(string const& path, ColumnLayout x, ColumnLayout y, bool sorted_by_x)
+{
+    require_little_endian(path);
+    auto file = make_shared<MappedFile>(path);
+    return make_shared<MappedSource>(file, raw_column(*file, x), raw_count(x, file->size()), file, raw_column(*file, y), raw_count(y, file->size()), sorted_by_x);
+}
+
+shared_ptr<MappedSource> MappedSource::open_raw(string const& x_path, ColumnLayout x, string const& y_path, ColumnLayout y, bool sorted_by_x)
+{
+    require_little_endian(x_path);
+    auto x_file = make_shared<MappedFile>(x_path);
+    auto y_file = make_shared<MappedFile>(y_path);
+    return make_shared<MappedSource>(x_file, raw_column(*x_file, x), raw_count(x, x_file->size()), y_file, raw_column(*y_file, y), raw_count(y, y_file->size()), sorted_by_x);
+}
+
+shared_ptr<MappedSource> MappedSource::open_npy(string const& path, size_t x_column, size_t y_column, bool sorted_by_x)
+{
+    require_little_endian(path);
+    auto file = make_shared<MappedFile>(path);
+    NpyArray a = parse_npy(*file, path);
+    return make_shared<MappedSource>(file, npy_column(*file, a, x_column, path), a.rows, file, npy_column(*file, a, y_column, path), a.rows, sorted_by_x);
+}
+
+shared_ptr<MappedSource> MappedSource::open_npy(string const& x_path, string const& y_path, bool sorted_by_x)
+{
+    require_little_endian(x_path);
+    auto x_file = make_shared<MappedFile>(x_path);
+    auto y_file = make_shared<MappedFile>(y_path);
+    NpyArray x = parse_npy(*x_file, x_path);
+    NpyArray y = parse_npy(*y_file, y_path);
+    if (x.columns != 1 || y.columns != 1)
+        throw runtime_error(x_path + " and " + y_path + " must be 1-D arrays");
+    if (x.rows != y.rows)
+        throw runtime_error(x_path + " and " + y_path + " must have the same length");
+    return make_shared<MappedSource>(x_file, npy_column(*x_file, x, 0, x_path), x.rows, y_file, npy_column(*y_file, y, 0, y_path), y.rows, sorted_by_x);
+}
+
+// Reads fields x_index and y_index of the line [begin, end)
+bool parse_csv_line(char const* begin, char const* end, char separator, size_t x_index, size_t y_index, Coordinate& c)
+{
+    size_t const last_index = max(x_index, y_index);
+    size_t field = 0;
+    bool x_found = false;
+    bool y_found = false;
+    char const* start = begin;
+    while (field <= last_index)
+    {
+        char const* stop = static_cast<char const*>(memchr(start, separator, end - start));
+        if (stop == nullptr)
+            stop = end;
+        if (field == x_index)
+            x_found = parse_number(start, stop, c.x);
+        if (field == y_index)
+            y_found = parse_number(start, stop, c.y);
+        if (stop == end)
+            break;
+        start = stop + 1;
+        field++;
+    }
+    return x_found && y_found;
+}
+
+// Finds the index of a column, from the header line [begin, end) if it is given by its name
+size_t csv_column_index(CsvColumn const& column, char const* begin, char const* end, char separator, string const& path)
+{
+    if (column.index)
+        return *column.index;
+    size_t field = 0;
+    char const* start = begin;
+    while (true)
+    {
+        char const* stop = static_cast<char const*>(memchr(start, separator, end - start));
+        if (stop == nullptr)
+            stop = end;
+        string_view name(start, stop - start);
+        while (!name.empty() && (name.back() == '\r' || name.back() == ' '))
+            name.remove_suffix(1);
+        while (!name.empty() && name.front() == ' ')
+            name.remove_prefix(1);
+        if (name == column.name)
+            return field;
+        if (stop == end)
+            throw runtime_error(path + " has no column " + column.name);
+        start = stop + 1;
+        field++;
+    }
+}
+
+size_t parse_csv_fields(char const* begin, char const* end, char separator, span<double> fields)
+{
+    size_t field = 0;
+    char const* start = begin;
+    while (true)
+    {
+        char const* stop = static_cast<char const*>(memchr(start, separator, end - start));
+        if (stop == nullptr)
+            stop = end;
+        if (field < fields.size() && !parse_number(start, stop, fields[field]))
+            fields[field] = numeric_limits<double>::quiet_NaN();
+        field++;
+        if (stop == end)
+            break;
+        start = stop + 1;
+    }
+    for (size_t f = field; f < fields.size(); f++)
+        fields[f] = numeric_limits<double>::quiet_NaN();
+    return field;
+}
+
+shared_ptr<Dataset> load_csv(string const& path, CsvColumn x, CsvColumn y, CsvOptions options, pmr::memory_resource* resource)
+{
+    MappedFile file { path };
+    if (!options.header && (!x.index || !y.index))
+        throw runtime_error("columns can only be given by their name if the file has a header line");
+    if (file.size() == 0)
+    {
+        // Not mapped, so there is nothing to search
+        if (!x.index || !y.index)
+            throw runtime_error(path + " has no header line");
+        return Dataset::make(pmr::vector<Coordinate>(resource));
+    }
+    char const* const begin = reinterpret_cast<char const*>(file.data());
+    char const* const end = begin + file.size();
+    char const* data = begin;
+    if (options.header)
+        data = next_line(begin, end);
+    char const* const header_end = data > begin && data[-1] == '\n' ? data - 1 : data;
+    size_t const x_index = csv_column_index(x, begin, header_end, options.separator, path);
+    size_t const y_index = csv_column_index(y, begin, header_end, options.separator, path);
+
+    // Split the data in chunks which start at the beginning of a line
+    size_t threads = options.threads == 0 ? max(1u, thread::hardware_concurrency()) : options.threads;
+    threads = max<size_t>(1, min<size_t>(threads, (end - data) / (1 << 16) + 1)); // Small files are not worth it
+    vector<char const*> bounds { data };
+    for (size_t t = 1; t < threads; t++)
+        bounds.push_back(max(bounds.back(), next_line(data + (end - data) * t / threads, end)));
+    bounds.push_back(end);
+
+    auto run = [threads](auto const& work) {
+        vector<exception_ptr> errors(threads);
+        vector<thread> workers;
+        workers.reserve(threads);
+        try
+        {
+            for (size_t t = 0; t < threads; t++)
+                workers.emplace_back([&, t]() {
+                    try
+                    {
+                        work(t);
+                    }
+                    catch (...)
+                    {
+                        errors[t] = current_exception();
+                    }
+                });
+        }
+        catch (...)
+        {
+            // A thread could not be started : the ones which were have to be joined before their vector is destroyed
+            for (auto& w : workers)
+                w.join();
+            throw;
+        }
+        for (auto& w : workers)
+            w.join();
+        for (auto& e : errors)
+            if (e)
+                rethrow_exception(e);
+    };
+
+    // First pass : count the lines of each chunk, to know where each one goes in the dataset
+    vector<size_t> lines(threads + 1, 0);
+    run([&](size_t t) {
+        size_t n = 0;
+        for (char const* p = bounds[t]; p < bounds[t + 1];)
+        {
+            char const* stop = next_line(p, bounds[t + 1]);
+            if (!is_blank(p, stop - (stop[-1] == '\n')))
+                n++;
+            p = stop;
+        }
+        lines[t + 1] = n;
+    });
+    for (size_t t = 1; t <= threads; t++)
+        lines[t] += lines[t - 1];
+
+    // Second pass : parse straight into the storage of the dataset
+    pmr::vector<Coordinate> points(lines.back(), Coordinate { 0., 0. }, resource);
+    run([&](size_t t) {
+        size_t i = lines[t];
+        for (char const* p = bounds[t]; p < bounds[t + 1];)
+        {
+            char const* stop = next_line(p, bounds[t + 1]);
+            char const* line_end = stop - (stop[-1] == '\n');
+            if (!is_blank(p, line_end))
+            {
+                if (!parse_csv_line(p, line_end, options.separator, x_index, y_index, points[i]))
+                    throw runtime_error(path + " : cannot read line \"" + string(p, line_end) + "\"");
+                i++;
+            }
+            p = stop;
+        }
+    });
+    return Dataset::make(move(points));
+}
+}
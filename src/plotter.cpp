@@ -18,13 +18,12 @@ SPDX identifier : GPL-3.0-or-later
 */
 #include <SDL2/SDL_image.h>
 #include <algorithm>
+#include <charconv>
 #include <chrono>
 #include <cmath>
-#include <iomanip>
 #include <limits>
 #include <plotter/plotter.hpp>
-#include <sstream>
-#include <thread>
+#include <utility>
 
 namespace plotter
 {
@@ -74,6 +73,41 @@ bool Plotter::internal_plot(bool save, std::string const& name)
 
         window.SetMinimumSize(min_w, min_h + plot_info_margin + info_height());
         Renderer renderer(window, -1, SDL_RENDERER_ACCELERATED);
+        // Subplots keep their drawings between frames : they are released before the renderer
+        struct TextureRelease
+        {
+            pmr::vector<SubPlot>& sub_plots;
+            ~TextureRelease()
+            {
+                for (auto& s : sub_plots)
+                    s.release_texture();
+            }
+        } texture_release { m_sub_plots };
+
+        // Stopped before the subplots' textures are released, when leaving
+        struct PrefetcherStop
+        {
+            unique_ptr<Prefetcher>& prefetcher;
+            ~PrefetcherStop() { prefetcher.reset(); }
+        } prefetcher_stop { m_prefetcher };
+        if (!save && m_prefetch_budget > 0)
+            m_prefetcher = make_unique<Prefetcher>(m_prefetch_budget);
+
+        // Producers wake the loop up through an event, until it leaves
+        struct NewDataHandlerReset
+        {
+            ~NewDataHandlerReset() { set_new_data_handler(nullptr); }
+        } new_data_handler_reset;
+        m_new_data_event = SDL_RegisterEvents(1);
+        m_new_data = false;
+        if (m_new_data_event != static_cast<uint32_t>(-1))
+            set_new_data_handler([type = m_new_data_event]() {
+                SDL_Event e {};
+                e.type = type;
+                SDL_PushEvent(&e);
+            });
+        // Static sources never change : then nothing is checked periodically
+        bool const polled = any_of(m_sub_plots.begin(), m_sub_plots.end(), [](SubPlot const& s) { return s.dynamic(); });
 
         m_running = true;
         m_subplot_mouse_selected = no_sub_plot_hovered;
@@ -81,101 +115,57 @@ bool Plotter::internal_plot(bool save, std::string const& name)
         m_size_cursor = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_SIZEALL);
         SDL_Event event;
         SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "1");
+        bool invalidated = true;
+        bool previewed = false; // The last frame was drawn while interacting
+        auto next_poll = chrono::steady_clock::now();
+        auto next_frame = next_poll;
+        auto next_update = next_poll; // Sources are not updated more often than frames are drawn
+        m_last_interaction = {};
         while (m_running)
         {
-            auto start = chrono::steady_clock::now();
-            while (SDL_PollEvent(&event))
+            m_frame_arena.reset();
+            // Sleep until an event comes, or until the sources are checked again, or the next frame can be drawn
+            auto const now = chrono::steady_clock::now();
+            auto wake = invalidated ? max(next_frame, now) : next_poll;
+            if (m_new_data)
+                wake = min(wake, max(next_update, now));
+            if (previewed && !invalidated && now < m_last_interaction + m_refine_delay)
+                wake = min(wake, m_last_interaction + m_refine_delay); // Then drawn at full quality. Once passed, it is not a reason to wake up anymore.
+            int timeout = -1; // Until an event comes
+            if (save)
+                timeout = 0;
+            else if (wake != chrono::steady_clock::time_point::max())
+                timeout = chrono::ceil<chrono::milliseconds>(wake - now).count();
+            if (SDL_WaitEventTimeout(&event, timeout))
             {
-                if (event.type == SDL_QUIT)
-                {
-                    m_running = false;
-                }
-                else if (event.type == SDL_KEYDOWN)
-                {
-                    switch (event.key.keysym.sym)
-                    {
-                    case SDLK_RIGHT:
-                    {
-                        for_each(m_sub_plots.begin(), m_sub_plots.end(), [](SubPlot& s) {
-                            s.event_x_move(-10);
-                        });
-                        break;
-                    }
-                    case SDLK_LEFT:
-                    {
-                        for_each(m_sub_plots.begin(), m_sub_plots.end(), [](SubPlot& s) {
-                            s.event_x_move(10);
-                        });
-                        break;
-                    }
-                    case SDLK_UP:
-                    {
-                        for_each(m_sub_plots.begin(), m_sub_plots.end(), [](SubPlot& s) {
-                            s.event_y_move(-10);
-                        });
-                        break;
-                    }
-                    case SDLK_DOWN:
-                    {
-                        for_each(m_sub_plots.begin(), m_sub_plots.end(), [](SubPlot& s) {
-                            s.event_y_move(10);
-                        });
-                        break;
-                    }
-                    default:
-                        break;
-                    }
-                    update_mouse_position();
-                }
-                else if (event.type == SDL_MOUSEWHEEL)
-                {
-                    update_mouse_position();
-                    size_t hovered = hovered_sub_plot();
-                    if (hovered != no_sub_plot_hovered)
-                        m_sub_plots[hovered].event_zoom(event.wheel.preciseY, m_mouse_x - base_x_of_hovered_subplot(), m_mouse_y - base_y_of_hovered_subplot());
-                }
-                else if (event.type == SDL_MOUSEMOTION)
-                {
-                    if (m_subplot_mouse_selected != no_sub_plot_hovered)
-                    {
-                        m_sub_plots[m_subplot_mouse_selected].event_x_move(event.motion.xrel);
-                        m_sub_plots[m_subplot_mouse_selected].event_y_move(-event.motion.yrel);
-                    }
-                    update_mouse_position();
-                }
-                else if (event.type == SDL_MOUSEBUTTONDOWN)
-                {
-                    update_mouse_position();
-                    m_subplot_mouse_selected = hovered_sub_plot();
-                    SDL_SetCursor(m_size_cursor);
-                }
-                else if (event.type == SDL_MOUSEBUTTONUP)
-                {
-                    m_subplot_mouse_selected = no_sub_plot_hovered;
-                    SDL_SetCursor(m_arrow_cursor);
-                }
-                else if (event.type == SDL_WINDOWEVENT)
-                {
-                    switch (event.window.event)
-                    {
-                    case SDL_WINDOWEVENT_SIZE_CHANGED:
-                    {
-                        for_each(m_sub_plots.begin(), m_sub_plots.end(), [&](SubPlot& s) {
-                            // TODO : if step is less than m_sub_plots.size()
-                            if (m_stacking_direction == StackingDirection::Vertical)
-                                s.event_resize(event.window.data1, (event.window.data2 - plot_info_margin - info_height()) / m_sub_plots.size());
-                            else
-                                s.event_resize(event.window.data1 / m_sub_plots.size(), event.window.data2 - plot_info_margin - info_height());
-                        });
-                        break;
-                    }
-                    default:
-                    {
-                        break;
-                    }
-                    }
-                }
+                // Everything which is already queued is handled at once, so that bursts of motion are one update
+                do
+                    invalidated |= handle_event(event);
+                while (SDL_PollEvent(&event));
+                invalidated |= apply_pending_input();
+            }
+            if ((m_new_data || chrono::steady_clock::now() >= next_poll) && chrono::steady_clock::now() >= next_update)
+            {
+                take_new_data_notification();
+                m_new_data = false;
+                for (auto& s : m_sub_plots)
+                    invalidated |= s.update_sources();
+                next_update = chrono::steady_clock::now() + min_frame_interval;
+                next_poll = polled ? chrono::steady_clock::now() + source_poll_interval : chrono::steady_clock::time_point::max();
             }
+            bool const interacting = !save && chrono::steady_clock::now() < m_last_interaction + m_refine_delay;
+            for (auto& s : m_sub_plots)
+                invalidated |= s.set_preview(interacting);
+            if (!interacting)
+                previewed = false; // Even if no subplot was a preview, and nothing is drawn
+            if (!m_running || !invalidated || chrono::steady_clock::now() < next_frame)
+                continue;
+            previewed = interacting;
+            invalidated = false;
+            next_frame = chrono::steady_clock::now() + min_frame_interval;
+
+            // Large drawings are split over frames, so that inputs are never kept waiting longer than this
+            m_frame_deadline = save ? chrono::steady_clock::time_point::max() : chrono::steady_clock::now() + frame_budget;
 
             renderer.SetDrawColor(255, 255, 255, 255); // Clear the screen
             renderer.Clear();
@@ -188,9 +178,9 @@ bool Plotter::internal_plot(bool save, std::string const& name)
                 int offset = 0;
                 for (auto& e : m_sub_plots)
                 {
-                    auto texture = e.internal_plot(renderer);
+                    Texture& texture = e.internal_plot(renderer);
                     renderer.SetTarget();
-                    renderer.Copy(*texture, NullOpt, Point { 0, offset });
+                    renderer.Copy(texture, NullOpt, Point { 0, offset });
                     offset += e.height();
                 }
             }
@@ -199,29 +189,30 @@ bool Plotter::internal_plot(bool save, std::string const& name)
                 int offset = 0;
                 for (auto& e : m_sub_plots)
                 {
-                    auto texture = e.internal_plot(renderer);
+                    Texture& texture = e.internal_plot(renderer);
                     renderer.SetTarget();
-                    renderer.Copy(*texture, NullOpt, Point { offset, 0 });
+                    renderer.Copy(texture, NullOpt, Point { offset, 0 });
                     offset += e.width();
                 }
             }
 
             renderer.Present();
+            m_last_frame_stats = { m_frame_arena.used(), m_frame_arena.upstream_allocations() };
+            for (auto const& s : m_sub_plots)
+                invalidated |= s.needs_redraw();
+            if (m_prefetcher)
+            {
+                vector<Prefetcher::Request> requests;
+                for (auto const& s : m_sub_plots)
+                    s.prefetch_requests(requests);
+                m_prefetcher->request(std::move(requests));
+            }
 
             if (save)
             {
                 save_img(window, renderer, name);
                 m_running = false;
             }
-            else
-            {
-                // Frame limiter
-                auto end = chrono::steady_clock::now();
-                std::chrono::duration<double> diff = end - start;
-                int duration_ms = round(diff.count() * 1000);
-                int to_wait = max(40 - duration_ms, 0); // Make the whole iteration take at least 1/25 s
-                this_thread::sleep_for(chrono::milliseconds(to_wait));
-            }
         }
     }
     catch (exception const& e)
@@ -233,17 +224,183 @@ bool Plotter::internal_plot(bool save, std::string const& name)
     return true;
 }
 
+// Returns whether the window has to be drawn again. Moves and zooms are accumulated, and applied by apply_pending_input().
+bool Plotter::handle_event(SDL_Event const& event)
+{
+    if (event.type == SDL_QUIT)
+    {
+        m_running = false;
+    }
+    else if (event.type == m_new_data_event)
+    {
+        m_new_data = true; // The sources are updated by the loop
+    }
+    else if (event.type == SDL_KEYDOWN)
+    {
+        update_mouse_position();
+        switch (event.key.keysym.sym)
+        {
+        case SDLK_RIGHT:
+        {
+            for_each(m_sub_plots.begin(), m_sub_plots.end(), [](SubPlot& s) {
+                s.event_x_move(-10);
+            });
+            m_last_interaction = chrono::steady_clock::now();
+            return true;
+        }
+        case SDLK_LEFT:
+        {
+            for_each(m_sub_plots.begin(), m_sub_plots.end(), [](SubPlot& s) {
+                s.event_x_move(10);
+            });
+            m_last_interaction = chrono::steady_clock::now();
+            return true;
+        }
+        case SDLK_UP:
+        {
+            for_each(m_sub_plots.begin(), m_sub_plots.end(), [](SubPlot& s) {
+                s.event_y_move(-10);
+            });
+            m_last_interaction = chrono::steady_clock::now();
+            return true;
+        }
+        case SDLK_DOWN:
+        {
+            for_each(m_sub_plots.begin(), m_sub_plots.end(), [](SubPlot& s) {
+                s.event_y_move(10);
+            });
+            m_last_interaction = chrono::steady_clock::now();
+            return true;
+        }
+        case SDLK_f:
+        {
+            for_each(m_sub_plots.begin(), m_sub_plots.end(), [](SubPlot& s) {
+                s.resume_follow();
+            });
+            return true;
+        }
+        default:
+            break;
+        }
+    }
+    else if (event.type == SDL_MOUSEWHEEL)
+    {
+        update_mouse_position();
+        size_t hovered = hovered_sub_plot();
+        if (hovered != m_pending_zoom_sub_plot)
+            apply_pending_input();
+        m_pending_zoom_sub_plot = hovered;
+        m_pending_zoom += event.wheel.preciseY; // Zooms compose by adding their exponents
+        m_last_interaction = chrono::steady_clock::now();
+        return true;
+    }
+    else if (event.type == SDL_MOUSEMOTION)
+    {
+        if (m_subplot_mouse_selected != no_sub_plot_hovered)
+        {
+            m_pending_x_move += event.motion.xrel;
+            m_pending_y_move -= event.motion.yrel;
+            m_last_interaction = chrono::steady_clock::now();
+        }
+        update_mouse_position();
+        return true; // The mouse coordinates are shown
+    }
+    else if (event.type == SDL_MOUSEBUTTONDOWN)
+    {
+        apply_pending_input();
+        update_mouse_position();
+        m_subplot_mouse_selected = hovered_sub_plot();
+        SDL_SetCursor(m_size_cursor);
+    }
+    else if (event.type == SDL_MOUSEBUTTONUP)
+    {
+        apply_pending_input();
+        bool const ended = m_subplot_mouse_selected != no_sub_plot_hovered && m_sub_plots[m_subplot_mouse_selected].end_pan();
+        m_subplot_mouse_selected = no_sub_plot_hovered;
+        m_last_interaction = {}; // The drag is over : no need to wait before drawing at full quality
+        SDL_SetCursor(m_arrow_cursor);
+        return ended;
+    }
+    else if (event.type == SDL_KEYUP)
+    {
+        bool ended = false;
+        for (auto& s : m_sub_plots)
+            ended |= s.end_pan();
+        return ended;
+    }
+    else if (event.type == SDL_WINDOWEVENT)
+    {
+        switch (event.window.event)
+        {
+        case SDL_WINDOWEVENT_SIZE_CHANGED:
+        {
+            for_each(m_sub_plots.begin(), m_sub_plots.end(), [&](SubPlot& s) {
+                // TODO : if step is less than m_sub_plots.size()
+                if (m_stacking_direction == StackingDirection::Vertical)
+                    s.event_resize(event.window.data1, (event.window.data2 - plot_info_margin - info_height()) / m_sub_plots.size());
+                else
+                    s.event_resize(event.window.data1 / m_sub_plots.size(), event.window.data2 - plot_info_margin - info_height());
+            });
+            break;
+        }
+        default:
+        {
+            break;
+        }
+        }
+        return true; // Exposed, shown, restored...
+    }
+    else if (event.type == SDL_RENDER_TARGETS_RESET || event.type == SDL_RENDER_DEVICE_RESET)
+    {
+        for (auto& s : m_sub_plots)
+            s.release_texture(); // Their content is lost
+        return true;
+    }
+    return false;
+}
+
+// Applies the moves and zooms accumulated since the last frame, and returns whether there were any
+bool Plotter::apply_pending_input()
+{
+    bool applied = false;
+    if (m_pending_zoom != 0.f && m_pending_zoom_sub_plot != no_sub_plot_hovered)
+    {
+        m_sub_plots[m_pending_zoom_sub_plot].event_zoom(m_pending_zoom, m_mouse_x - base_x_of_hovered_subplot(), m_mouse_y - base_y_of_hovered_subplot());
+        applied = true;
+    }
+    m_pending_zoom = 0.f;
+    m_pending_zoom_sub_plot = no_sub_plot_hovered;
+    if ((m_pending_x_move != 0 || m_pending_y_move != 0) && m_subplot_mouse_selected != no_sub_plot_hovered)
+    {
+        m_sub_plots[m_subplot_mouse_selected].event_x_move(m_pending_x_move);
+        m_sub_plots[m_subplot_mouse_selected].event_y_move(m_pending_y_move);
+        applied = true;
+    }
+    m_pending_x_move = 0;
+    m_pending_y_move = 0;
+    return applied;
+}
+
 void Plotter::center_sprite(Renderer& renderer, Texture& texture, int x, int y)
 {
     renderer.Copy(texture, NullOpt, { x - texture.GetWidth() / 2, y - texture.GetHeight() / 2 });
 }
 
+Surface Plotter::render_text(Font& font, pmr::string const& text)
+{
+    // SDL2pp only renders std::string : the text is given to SDL_ttf directly, so that it is not copied out of the resource
+    SDL_Surface* surface = TTF_RenderUTF8_Blended(font.Get(), text.c_str(), SDL_Color(0, 0, 0, 255));
+    if (surface == nullptr)
+        throw Exception("TTF_RenderUTF8_Blended");
+    return Surface(surface);
+}
+
 std::string Plotter::to_str(double nb, int nb_digits)
 {
-    ostringstream out;
-    out << setprecision(nb_digits);
-    out << nb;
-    return out.str();
+    // Same output as a stream with setprecision(nb_digits), but short enough to never leave the string's own buffer
+    char buffer[32];
+    auto result = to_chars(buffer, buffer + sizeof(buffer), nb, chars_format::general, nb_digits);
+    return string(buffer, result.ptr);
 }
 
 int Plotter::info_height() const
@@ -297,20 +454,30 @@ void Plotter::draw_info_box(SDL2pp::Renderer& renderer)
     }
 
     int const w = width() - 2 * info_box_hmargin;
+    if (m_info_labels_width != w || m_info_labels.size() != m_infos.size())
+    {
+        // Labels only change with the width, so they are not rebuilt at each frame
+        m_info_labels.clear();
+        for (auto const& info : m_infos)
+        {
+            pmr::string text(info.name, m_info_labels.get_allocator());
+            if (m_small_font.GetHeight() + info_margin + (text.size() + 1) * m_small_font_advance > (size_t)w / 2) // make sure it will not take too much space
+            {
+                int extra_chars = ((m_small_font.GetHeight() + info_margin + (text.size() + 1) * m_small_font_advance) - w / 2) / m_small_font_advance;
+                text.resize(text.size() - extra_chars - 4);
+                text += "...";
+            }
+            m_info_labels.push_back(move(text));
+        }
+        m_info_labels_width = w;
+    }
     size_t i = 0;
     for (; i < m_infos.size(); i++)
     {
         int hpos = (i % 2 == 0) ? 0 : w / 2;
         renderer.SetDrawColor(m_infos[i].color);
         renderer.FillRect(Rect { info_box_hmargin + hpos, offset, m_small_font.GetHeight(), m_small_font.GetHeight() });
-        string text = m_infos[i].name;
-        if (m_small_font.GetHeight() + info_margin + (text.size() + 1) * m_small_font_advance > (size_t)w / 2) // make sure it will not take too much space
-        {
-            int extra_chars = ((m_small_font.GetHeight() + info_margin + (text.size() + 1) * m_small_font_advance) - w / 2) / m_small_font_advance;
-            text.resize(text.size() - extra_chars - 4);
-            text += "...";
-        }
-        Texture name = { renderer, m_small_font.RenderUTF8_Blended(text, SDL_Color(0, 0, 0, 255)) };
+        Texture name = { renderer, render_text(m_small_font, m_info_labels[i]) };
         renderer.Copy(name, NullOpt, { info_box_hmargin + hpos + m_small_font.GetHeight() + info_margin, offset });
         offset += (i % 2 == 0) ? 0 : info_margin + m_small_font.GetHeight();
     }
@@ -337,8 +504,9 @@ void Plotter::draw_info_box(SDL2pp::Renderer& renderer)
     }
     double x = m_sub_plots[h].from_plot_x(m_mouse_x - x_offset);
     double y = m_sub_plots[h].from_plot_y(m_mouse_y - y_offset);
-    string text = "x : " + to_str(x) + ", y : " + to_str(y);
-    Texture mouse_sprite { renderer, m_small_font.RenderUTF8_Blended(text, SDL_Color(0, 0, 0, 255)) };
+    m_mouse_text.clear();
+    m_mouse_text.append("x : ").append(m_sub_plots[h].x_label(x, false)).append(", y : ").append(to_str(y));
+    Texture mouse_sprite { renderer, render_text(m_small_font, m_mouse_text) };
     renderer.Copy(mouse_sprite, NullOpt, { info_box_hmargin, offset });
 }
 
@@ -388,9 +556,14 @@ void Plotter::set_window(double x, double y, double w, double h, int n)
     m_sub_plots.at(n).set_window(x, y, w, h);
 }
 
+void Plotter::set_follow(optional<double> width, int n)
+{
+    m_sub_plots.at(n).set_follow(width);
+}
+
 SubPlot& Plotter::add_sub_plot(string const& title, optional<string> x_title, optional<string> y_title)
 {
-    m_sub_plots.push_back(SubPlot { *this, title, x_title, y_title, m_small_font_advance });
+    m_sub_plots.push_back(SubPlot { *this, title, x_title, y_title, m_small_font_advance, m_resource });
     return m_sub_plots.back();
 }
 
@@ -407,21 +580,28 @@ void Plotter::save_img(Window const& window, Renderer& renderer, string name)
 
 void Plotter::construct(string const& title, optional<string> x_title, optional<string> y_title)
 {
-    m_sub_plots.push_back(SubPlot { *this, title, x_title, y_title, m_small_font_advance });
+    m_sub_plots.push_back(SubPlot { *this, title, x_title, y_title, m_small_font_advance, m_resource });
     if (!m_small_font.IsFixedWidth())
     {
         throw runtime_error("The small font has to be fixed width");
     }
 }
 
-std::unique_ptr<SDL2pp::Texture> SubPlot::internal_plot(Renderer& renderer)
+SDL2pp::Texture& SubPlot::internal_plot(Renderer& renderer)
 {
-    m_texture = make_unique<Texture>(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, width(), height());
+    rebase_x_origin();
+    // The last drawing is reused while neither the view, nor the data, nor the size changed
+    if (m_texture && !needs_redraw() && m_texture->GetWidth() == width() && m_texture->GetHeight() == height())
+        return *m_texture;
+    bool const data_changed = m_dirty;
+    m_dirty = false; // Before drawing : what is found out while drawing, such as a new label margin, needs another frame
+    if (!m_texture || m_texture->GetWidth() != width() || m_texture->GetHeight() != height())
+        m_texture = make_unique<Texture>(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, width(), height());
     renderer.SetTarget(*m_texture);
 
     if (m_dirty_axis)
     {
-        m_axis = determine_axis();
+        determine_axis();
         m_dirty_axis = false;
     }
 
@@ -429,7 +609,7 @@ std::unique_ptr<SDL2pp::Texture> SubPlot::internal_plot(Renderer& renderer)
     renderer.Clear();
     renderer.SetDrawColor(0, 0, 0, 255);
     renderer.DrawRect(Rect { hmargin + y_axis_name_size() + m_x_label_margin, top_margin + title_size(), m_width, m_height }); // Draw the plot box
-    Texture title_sprite { renderer, m_plotter.m_big_font.RenderUTF8_Blended(m_title, SDL_Color(0, 0, 0, 255)) };
+    Texture title_sprite { renderer, Plotter::render_text(m_plotter.m_big_font, m_title) };
     if (m_title_height != title_sprite.GetHeight())
     {
         m_title_height = title_sprite.GetHeight();
@@ -438,27 +618,188 @@ std::unique_ptr<SDL2pp::Texture> SubPlot::internal_plot(Renderer& renderer)
     Plotter::center_sprite(renderer, title_sprite, hmargin + m_width / 2 + y_axis_name_size() + m_x_label_margin, (top_margin + title_size()) / 2);
     draw_axis_titles(renderer);
     draw_axis(m_axis, renderer);
-    draw_content(renderer);
-    return move(m_texture);
+    draw_content(renderer, data_changed);
+    return *m_texture;
 }
 
-void SubPlot::draw_content(SDL2pp::Renderer& renderer)
+void SubPlot::draw_content(SDL2pp::Renderer& renderer, bool entirely)
 {
-    Texture sprite { renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, width() - hmargin, top_margin + title_size() + m_height };
-    sprite.SetBlendMode(SDL_BLENDMODE_BLEND);
-    renderer.SetTarget(sprite);
-    renderer.SetDrawColor(0, 0, 0, 0);
-    renderer.Clear();
+    Rect const area { hmargin + y_axis_name_size() + m_x_label_margin, top_margin + title_size(), m_width, m_height };
+    int const w = width() - hmargin;
+    int const h = area.y + area.h;
+    auto const make_content = [&] {
+        auto t = make_unique<Texture>(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, w, h);
+        t->SetBlendMode(SDL_BLENDMODE_BLEND);
+        return t;
+    };
+    auto const clear = [&](Texture& t) {
+        renderer.SetTarget(t);
+        renderer.SetDrawColor(0, 0, 0, 0);
+        renderer.Clear();
+    };
+
+    // A pan by whole pixels moves what was drawn, and only the strips it uncovers are drawn
+    ContentView const view { area, m_x_offset, m_y_offset, m_x_zoom, m_y_zoom };
+    double const x_shift = (m_x_offset - m_content_view.x_offset) * m_x_zoom;
+    double const y_shift = (m_content_view.y_offset - m_y_offset) * m_y_zoom;
+    int const dx = static_cast<int>(lround(clamp(x_shift, -1e9, 1e9)));
+    int const dy = static_cast<int>(lround(clamp(y_shift, -1e9, 1e9)));
+    double const error = m_blit_error + abs(x_shift - dx) + abs(y_shift - dy);
+    bool const same_view = m_content && m_content->GetWidth() == w && m_content->GetHeight() == h && m_content_view.area == area
+        && m_content_view.x_zoom == m_x_zoom && m_content_view.y_zoom == m_y_zoom;
+    bool const moved = dx != 0 || dy != 0;
+    if (m_progress && (entirely || m_preview || m_progress->view != view))
+        m_progress.reset(); // Drawn for a view which is not the current one anymore
+    if (m_progress)
+    {
+        if (draw_data(renderer, *m_content_spare))
+        {
+            swap(m_content, m_content_spare);
+            m_content_view = m_progress->view;
+            m_progress.reset();
+            m_content_preview = false;
+        }
+    }
+    else if (entirely || !same_view || abs(dx) >= m_width || abs(dy) >= m_height || m_blits >= max_blits || error > max_blit_error)
+    {
+        if (!m_content || m_content->GetWidth() != w || m_content->GetHeight() != h)
+        {
+            m_content = make_content();
+            m_content_spare.reset();
+            m_content_view = {}; // Blank : drawn again until something fits
+        }
+        if (!m_content_spare)
+            m_content_spare = make_content();
+        clear(*m_content_spare);
+        if (m_preview)
+        {
+            // Drawn aside, and only shown if it fits in the frame : otherwise the former content stays
+            if (draw_data_once(renderer, *m_content_spare))
+            {
+                swap(m_content, m_content_spare);
+                m_content_view = view;
+                m_content_preview = true;
+            }
+        }
+        else
+        {
+            // Drawn into the spare texture, within the frame budget : the content is replaced once it is complete
+            m_progress = Progress { view, true };
+            if (draw_data(renderer, *m_content_spare))
+            {
+                swap(m_content, m_content_spare);
+                m_content_view = view;
+                m_progress.reset();
+                m_content_preview = false;
+            }
+            else if (chrono::steady_clock::now() < m_plotter.m_frame_deadline)
+            {
+                // Shown until the drawing at full quality is complete, or what it could draw in the rest of the frame
+                bool const preview = exchange(m_preview, true);
+                clear(*m_content);
+                m_content_preview = true;
+                m_content_view = view;
+                draw_data_once(renderer, *m_content);
+                m_preview = preview;
+            }
+        }
+        m_blits = 0;
+        m_blit_error = 0.;
+    }
+    else if (moved)
+    {
+        if (!m_content_spare)
+            m_content_spare = make_content();
+        clear(*m_content_spare);
+        m_content->SetBlendMode(SDL_BLENDMODE_NONE); // Copied as is, transparency included
+        renderer.Copy(*m_content, area, Point { area.x + dx, area.y + dy });
+        m_content->SetBlendMode(SDL_BLENDMODE_BLEND);
+        swap(m_content, m_content_spare);
+        m_content_view = view;
+        bool complete = true;
+        if (dx != 0)
+        {
+            m_clip = Rect { dx > 0 ? area.x : area.x + area.w + dx, area.y, abs(dx), area.h };
+            complete = draw_data_once(renderer, *m_content) && complete;
+        }
+        if (dy != 0)
+        {
+            // The columns of the first strip were drawn on its whole height, so the corner is left out
+            m_clip = Rect { dx > 0 ? area.x + dx : area.x, dy > 0 ? area.y : area.y + area.h + dy, area.w - abs(dx), abs(dy) };
+            complete = draw_data_once(renderer, *m_content) && complete;
+        }
+        m_clip.reset();
+        m_content_preview |= m_preview || !complete;
+        if (!complete && !m_preview)
+            m_dirty = true; // The whole content is drawn again during the next frames
+        m_blits++;
+        m_blit_error = error;
+    }
+    m_content_behind = m_content_view != view;
+
     renderer.SetTarget(*m_texture);
-    for (auto const& e : m_collections)
+    renderer.Copy(*m_content, area, Point { area.x, area.y });
+}
+
+bool SubPlot::draw_data(SDL2pp::Renderer& renderer, Texture& into)
+{
+    pmr::vector<Coordinate> scratch(&m_plotter.m_frame_arena); // Decimated or sampled points
+    size_t const first = m_progress->item;
+    for (size_t i = first; i < m_collections.size() + m_functions.size(); i++)
     {
-        plot_collection(e, renderer, sprite);
+        if (i != first && chrono::steady_clock::now() >= m_plotter.m_frame_deadline)
+        {
+            m_progress->item = i; // Asking the next source could take the rest of the frame
+            return false;
+        }
+        bool const complete = i < m_collections.size()
+            ? plot_collection(m_collections[i], renderer, into, scratch)
+            : plot_function(m_functions[i - m_collections.size()], renderer, into, scratch);
+        if (!complete)
+        {
+            m_progress->item = i;
+            return false;
+        }
     }
-    for (auto const& e : m_functions)
+    return true;
+}
+
+bool SubPlot::draw_data_once(SDL2pp::Renderer& renderer, Texture& into)
+{
+    auto const progress = exchange(m_progress, Progress { {}, false });
+    bool const complete = draw_data(renderer, into);
+    m_progress = progress; // The drawing at full quality, if any, goes on where it was
+    return complete;
+}
+
+pair<int, int> SubPlot::drawn_columns() const
+{
+    int left = hmargin + y_axis_name_size() + m_x_label_margin;
+    int right = left + m_width;
+    if (m_clip)
     {
-        plot_function(e, renderer, sprite);
+        left = max(left, m_clip->x - strip_margin);
+        right = min(right, m_clip->x + m_clip->w + strip_margin);
     }
-    renderer.Copy(sprite, Rect { hmargin + y_axis_name_size() + m_x_label_margin, top_margin + title_size(), m_width, m_height }, { hmargin + y_axis_name_size() + m_x_label_margin, top_margin + title_size() });
+    return { left, right };
+}
+
+bool SubPlot::set_preview(bool preview)
+{
+    m_preview = preview;
+    if (preview || !m_content_preview || m_progress)
+        return false; // The drawing in progress replaces the preview
+    m_content_preview = false;
+    m_dirty = true;
+    return true;
+}
+
+bool SubPlot::end_pan()
+{
+    if (m_blits == 0)
+        return false;
+    m_dirty = true;
+    return true;
 }
 
 int SubPlot::x_axis_name_size() const
@@ -478,10 +819,12 @@ int SubPlot::title_size() const
     return m_title_height;
 }
 
-tuple<vector<SubPlot::Axis>, vector<SubPlot::Axis>> SubPlot::determine_axis()
+void SubPlot::determine_axis()
 {
-    vector<SubPlot::Axis> x;
-    vector<SubPlot::Axis> y;
+    // The vectors of m_axis are reused, so this does not allocate once they are large enough
+    auto& [x, y] = m_axis;
+    x.clear();
+    y.clear();
     // Secondary axis :
     double x_max = from_plot_x(m_width);
     double x_min = from_plot_x(0);
@@ -523,12 +866,40 @@ tuple<vector<SubPlot::Axis>, vector<SubPlot::Axis>> SubPlot::determine_axis()
     if (old_x_label_margin != m_x_label_margin)
         event_resize(old_width, height());
 
-    for (int i = 0; i < max_nb_vertical_axis + 1; i++)
+    if (m_time_axis)
+    {
+        // Round durations, at round times : ticks are computed on the timestamps themselves
+        int64_t const units_per_second = m_time_axis->units_per_second;
+        int64_t const origin = m_time_axis->origin;
+        constexpr double limit = 4e18;
+        int64_t const first = origin + static_cast<int64_t>(floor(clamp(x_min, -limit, limit)));
+        m_x_time_step = time_grid_step(max_nb_vertical_axis, delta_x, units_per_second);
+        // Times are long : labels must not overlap
+        int const label_width = (time_str(first, units_per_second, m_x_time_step, false, &m_plotter.m_frame_arena).size() + 2) * m_plotter.m_small_font_advance;
+        if (label_width > min_spacing_between_axis)
+            m_x_time_step = time_grid_step(m_width / label_width, delta_x, units_per_second);
+        int64_t tick = first / m_x_time_step * m_x_time_step;
+        if (tick < first)
+            tick += m_x_time_step;
+        for (int i = 0; i < max_nb_vertical_axis + 1; i++, tick += m_x_time_step)
+        {
+            double const relative = static_cast<double>(tick - origin);
+            int abscissa = to_plot_x<int>(relative);
+            if (x_is_in_plot(abscissa))
+            {
+                y.push_back({ abscissa, relative, false });
+            }
+        }
+    }
+    else
     {
-        int abscissa = to_plot_x<int>(rounded_x_min + i * x_step);
-        if (x_is_in_plot(abscissa))
+        for (int i = 0; i < max_nb_vertical_axis + 1; i++)
         {
-            y.push_back({ abscissa, rounded_x_min + i * x_step, false });
+            int abscissa = to_plot_x<int>(rounded_x_min + i * x_step);
+            if (x_is_in_plot(abscissa))
+            {
+                y.push_back({ abscissa, rounded_x_min + i * x_step, false });
+            }
         }
     }
     // Main axis :
@@ -536,15 +907,13 @@ tuple<vector<SubPlot::Axis>, vector<SubPlot::Axis>> SubPlot::determine_axis()
     {
         x.push_back({ to_plot_y<int>(0.), 0., true });
     }
-    if (x_is_in_plot(to_plot_x<int>(0)))
+    if (!m_time_axis && x_is_in_plot(to_plot_x<int>(0)))
     {
         y.push_back({ to_plot_x<int>(0.), 0., true });
     }
-
-    return { x, y };
 }
 
-void SubPlot::draw_axis(tuple<vector<Axis>, vector<Axis>> const& axis, Renderer& renderer)
+void SubPlot::draw_axis(tuple<pmr::vector<Axis>, pmr::vector<Axis>> const& axis, Renderer& renderer)
 {
     for (auto& e : get<0>(axis))
     {
@@ -648,7 +1017,7 @@ bool SubPlot::y_is_in_plot(int y) const
 
 void SubPlot::draw_vertical_line_number(double nb, int x, SDL2pp::Renderer& renderer)
 {
-    Texture sprite { renderer, m_plotter.m_small_font.RenderUTF8_Blended(Plotter::to_str(nb), SDL_Color(0, 0, 0, 255)) };
+    Texture sprite { renderer, Plotter::render_text(m_plotter.m_small_font, x_label(nb, true)) };
     Plotter::center_sprite(renderer, sprite, x, top_margin + title_size() + m_height + m_bottom_margin / 2);
 }
 
@@ -662,22 +1031,64 @@ void SubPlot::draw_axis_titles(SDL2pp::Renderer& renderer)
 {
     if (m_y_title)
     {
-        Texture sprite { renderer, m_plotter.m_small_font.RenderUTF8_Blended(*m_y_title, SDL_Color(0, 0, 0, 255)) };
+        Texture sprite { renderer, Plotter::render_text(m_plotter.m_small_font, *m_y_title) };
         renderer.Copy(sprite, NullOpt, { hmargin + m_plotter.text_margin, m_height / 2 + sprite.GetWidth() / 2 + top_margin + title_size() }, 270, Point { 0, 0 });
     }
     if (m_x_title)
     {
-        Texture sprite { renderer, m_plotter.m_small_font.RenderUTF8_Blended(*m_x_title, SDL_Color(0, 0, 0, 255)) };
+        Texture sprite { renderer, Plotter::render_text(m_plotter.m_small_font, *m_x_title) };
         Plotter::center_sprite(renderer, sprite, hmargin + y_axis_name_size() + m_x_label_margin + m_width / 2, top_margin + title_size() + m_height + m_bottom_margin + x_axis_name_size() / 2);
     }
 }
 
-void SubPlot::plot_collection(Collection const& c, SDL2pp::Renderer& renderer, Texture& into)
+bool SubPlot::plot_collection(Collection const& c, SDL2pp::Renderer& renderer, Texture& into, pmr::vector<Coordinate>& scratch)
 {
-    if (c.points.size() == 0)
-        return;
+    if (m_progress->point > 0)
+        return plot_points(m_progress->points, c.get_color(), c.display_points, c.display_lines, c.point_type, c.line_style, renderer, into); // The points the previous frame drew part of
+    auto const [left, right] = drawn_columns();
+    View const view {
+        from_plot_x(left),
+        from_plot_x(right),
+        static_cast<size_t>(m_preview ? max(1, (right - left) / preview_column_width) : right - left),
+        m_preview || c.display_points == DisplayPoints::No, // Decimating would hide markers, which previews do not draw
+        x_origin(),
+    };
+    View const asked = source_view(view, *c.data);
+    shared_ptr<Prefetcher::Entry const> prefetched; // Kept while its points are drawn
+    if (m_plotter.m_prefetcher)
+        prefetched = m_plotter.m_prefetcher->find(*c.data, asked);
+    span<Coordinate const> points = prefetched ? Prefetcher::points_in(*prefetched, asked) : c.data->visible(asked, scratch);
+    if (asked.x_origin != view.x_origin)
+    {
+        // A source without a time axis, with others which have one : its x are absolute
+        double const shift = static_cast<double>(view.x_origin);
+        if (points.data() == scratch.data())
+            scratch.resize(points.size());
+        else
+            scratch.assign(points.begin(), points.end());
+        for (auto& p : scratch)
+            p.x -= shift;
+        points = scratch;
+    }
+    m_progress->prefetched = prefetched;
+    m_progress->points = points;
+    bool const complete = plot_points(points, c.get_color(), c.display_points, c.display_lines, c.point_type, c.line_style, renderer, into);
+    if (!complete && m_progress->resumable && (!prefetched || points.data() == scratch.data()))
+    {
+        // The scratch is the frame's, and the source's points may change before the next frame : only a prefetched entry outlives them
+        m_progress_points.assign(points.begin(), points.end());
+        m_progress->points = m_progress_points;
+    }
+    return complete;
+}
+
+bool SubPlot::plot_points(span<Coordinate const> points, SDL2pp::Color normal, DisplayPoints dp, DisplayLines dl, PointType pt, LineStyle ls, SDL2pp::Renderer& renderer, Texture& into)
+{
+    if (points.size() == 0)
+        return true;
 
-    SDL2pp::Color normal = c.get_color();
+    if (m_preview && dl == DisplayLines::Yes)
+        dp = DisplayPoints::No; // The line is enough for a preview
     SDL2pp::Color transparent = { normal.r, normal.g, normal.b, 190 }; // Used for home-made antialiasing
 
     // This builds the maximal segment that can be drawn
@@ -688,7 +1099,7 @@ void SubPlot::plot_collection(Collection const& c, SDL2pp::Renderer& renderer, T
     // Creates a transparent background to help antialiasing
     renderer.SetDrawColor(255, 255, 255, 0);
     renderer.FillRect(Rect::FromCorners(0, 0, 2 * max_segment_width, 5 * line_width_unit));
-    if (c.line_style == LineStyle::Solid)
+    if (ls == LineStyle::Solid)
     {
         renderer.SetDrawColor(transparent);
         renderer.DrawLine(0, line_width_unit, 2 * max_segment_width, line_width_unit);
@@ -697,53 +1108,75 @@ void SubPlot::plot_collection(Collection const& c, SDL2pp::Renderer& renderer, T
         renderer.SetDrawColor(normal);
         renderer.DrawLine(0, 2 * line_width_unit, 2 * max_segment_width, 2 * line_width_unit);
     }
-    else if (c.line_style == LineStyle::Dashed)
+    else if (ls == LineStyle::Dashed)
     {
         int w = 0;
-        int dash_len = 15;
         while (w < 2 * max_segment_width)
         {
             renderer.SetDrawColor(transparent);
-            renderer.DrawLine(w, line_width_unit, w + dash_len, line_width_unit);
-            renderer.DrawLine(w, 3 * line_width_unit, w + dash_len, 3 * line_width_unit);
+            renderer.DrawLine(w, line_width_unit, w + dash_length, line_width_unit);
+            renderer.DrawLine(w, 3 * line_width_unit, w + dash_length, 3 * line_width_unit);
 
             renderer.SetDrawColor(normal);
-            renderer.DrawLine(w, 2 * line_width_unit, w + dash_len, 2 * line_width_unit);
-            w += 2 * dash_len;
+            renderer.DrawLine(w, 2 * line_width_unit, w + dash_length, 2 * line_width_unit);
+            w += 2 * dash_length;
         }
     }
     renderer.SetTarget(into);
+    if (m_clip)
+        renderer.SetClipRect(*m_clip);
 
-    size_t lenght_drawn = 0;
-    for (size_t i = 0; i < c.points.size() - 1; i++)
+    size_t const first = m_progress->point; // Where the previous frame stopped
+    for (size_t i = first; i < points.size() - 1; i++)
     {
-        if ((to_plot_x<int>(c.points[i].x) < hmargin + y_axis_name_size() + m_x_label_margin && to_plot_x<int>(c.points[i + 1].x) < hmargin + y_axis_name_size() + m_x_label_margin)
-            || (to_plot_x<int>(c.points[i].x) > hmargin + y_axis_name_size() + m_x_label_margin + m_width && to_plot_x<int>(c.points[i + 1].x) > hmargin + y_axis_name_size() + m_x_label_margin + m_width)
-            || (to_plot_y<int>(c.points[i].y) < top_margin + title_size() && to_plot_y<int>(c.points[i + 1].y) < top_margin + title_size())
-            || (to_plot_y<int>(c.points[i].y) > top_margin + title_size() + m_height && to_plot_y<int>(c.points[i + 1].y) > top_margin + title_size() + m_height))
+        if (i != first && (i - first) % points_per_deadline_check == 0 && chrono::steady_clock::now() >= m_plotter.m_frame_deadline)
+        {
+            m_progress->point = i;
+            renderer.SetTarget(*m_texture);
+            return false;
+        }
+        if (!isfinite(points[i].x) || !isfinite(points[i].y) || !isfinite(points[i + 1].x) || !isfinite(points[i + 1].y))
+        {
+            // Missing values break the line
+            if (dp == DisplayPoints::Yes && isfinite(points[i].x) && isfinite(points[i].y))
+                draw_point(points[i], renderer, pt);
+            continue;
+        }
+        if ((to_plot_x<int>(points[i].x) < hmargin + y_axis_name_size() + m_x_label_margin && to_plot_x<int>(points[i + 1].x) < hmargin + y_axis_name_size() + m_x_label_margin)
+            || (to_plot_x<int>(points[i].x) > hmargin + y_axis_name_size() + m_x_label_margin + m_width && to_plot_x<int>(points[i + 1].x) > hmargin + y_axis_name_size() + m_x_label_margin + m_width)
+            || (to_plot_y<int>(points[i].y) < top_margin + title_size() && to_plot_y<int>(points[i + 1].y) < top_margin + title_size())
+            || (to_plot_y<int>(points[i].y) > top_margin + title_size() + m_height && to_plot_y<int>(points[i + 1].y) > top_margin + title_size() + m_height))
             continue; // Both points are outside of the screen, and on the same side : there is nothing to draw
-        if (c.display_points == DisplayPoints::Yes)
-            draw_point(c.points[i], renderer, c.point_type);
-        if (c.display_lines == DisplayLines::Yes)
-            draw_line(to_point(c.points[i]), to_point(c.points[i + 1]), renderer, into, lenght_drawn, total_segment);
+        if (dp == DisplayPoints::Yes)
+            draw_point(points[i], renderer, pt);
+        if (dl == DisplayLines::Yes)
+            draw_line(to_point(points[i]), to_point(points[i + 1]), renderer, into, total_segment);
     }
-    if (c.display_points == DisplayPoints::Yes)
-        draw_point(c.points.back(), renderer, c.point_type);
+    if (dp == DisplayPoints::Yes && isfinite(points.back().x) && isfinite(points.back().y))
+        draw_point(points.back(), renderer, pt);
+    if (m_clip)
+        renderer.SetClipRect();
     renderer.SetTarget(*m_texture);
+    m_progress->point = 0;
+    m_progress->prefetched.reset();
+    m_progress->points = {};
+    return true;
 }
 
-void SubPlot::plot_function(Function const& f, SDL2pp::Renderer& renderer, Texture& into)
+bool SubPlot::plot_function(Function const& f, SDL2pp::Renderer& renderer, Texture& into, pmr::vector<Coordinate>& scratch)
 {
-    double x_min = from_plot_x(hmargin + y_axis_name_size() + m_x_label_margin);
-    double x_max = from_plot_x(hmargin + y_axis_name_size() + m_x_label_margin + m_width);
-    vector<Coordinate> coordinates;
-    coordinates.reserve(sampling_number_of_points);
-    for (int i = 0; i < sampling_number_of_points; i++)
+    auto const [left, right] = drawn_columns();
+    double x_min = from_plot_x(left);
+    double x_max = from_plot_x(right);
+    int const nb_points = max(2, sampling_number_of_points * (right - left) / m_width / (m_preview ? preview_sampling_divisor : 1)); // The same density on a strip
+    scratch.clear();
+    scratch.reserve(nb_points);
+    for (int i = 0; i < nb_points; i++)
     {
-        double v = x_min + i * (x_max - x_min) / sampling_number_of_points;
-        coordinates.push_back({ v, f.function(v) });
+        double v = x_min + i * (x_max - x_min) / nb_points;
+        scratch.push_back({ v, f.function(v + static_cast<double>(x_origin())) });
     }
-    plot_collection(Collection { coordinates, f.name, DisplayPoints::No, DisplayLines::Yes, PointType::Square, f.line_style, f.color }, renderer, into);
+    return plot_points(scratch, f.get_color(), DisplayPoints::No, DisplayLines::Yes, PointType::Square, f.line_style, renderer, into);
 }
 
 SubPlot::ScreenPoint SubPlot::to_point(Coordinate const& c) const
@@ -861,7 +1294,7 @@ void SubPlot::draw_cross(SDL2pp::Renderer& renderer, int x, int y, int length)
     renderer.DrawLine(x, y + length / 2, x, y - length / 2);
 }
 
-void SubPlot::draw_line(ScreenPoint const& p1, ScreenPoint const& p2, Renderer& renderer, Texture& into, size_t& lenght_drawn, SDL2pp::Texture& total_segment)
+void SubPlot::draw_line(ScreenPoint const& p1, ScreenPoint const& p2, Renderer& renderer, Texture& into, SDL2pp::Texture& total_segment)
 {
     int64_t x1 = p1.x;
     int64_t x2 = p2.x;
@@ -883,30 +1316,43 @@ void SubPlot::draw_line(ScreenPoint const& p1, ScreenPoint const& p2, Renderer&
     int x_offset = static_cast<int>(2. * line_width_unit * sin(angle)); // offset due to rotation
     int y_offset = static_cast<int>(-2. * line_width_unit * cos(angle));
     Point dst_point { x1 + x_offset, y1 + y_offset };
+    // Dashes are placed along the line from where the data's origin is on the screen, which moves with the data : the
+    // strips drawn after a pan go on with the dashes of the content which was moved, whatever part of the line they draw
+    double const along = (x1 - to_plot_x<double>(0.)) * cos(angle) + (y1 - to_plot_y<double>(0.)) * sin(angle);
+    double const period = 2 * dash_length;
+    int const segment_offset = static_cast<int>(fmod(fmod(along, period) + period, period));
     angle *= 360 / (2 * numbers::pi_v<double>); // to degree
-    int segment_offset = lenght_drawn % (int)ceil(max_w);
     renderer.Copy(total_segment, Rect { segment_offset, 0, w, 5 * line_width_unit }, dst_point, angle, Point { 0, 0 });
-    lenght_drawn += w - line_width_unit;
 }
 
 void SubPlot::add_collection(Collection const& c)
 {
+    auto const time_axis = c.data->time_axis();
+    if (time_axis && m_time_axis && time_axis->units_per_second != m_time_axis->units_per_second)
+        throw runtime_error("the timestamps of " + string(c.name) + " are not in the same unit as the other ones of the subplot");
+    m_dirty = true;
     m_collections.push_back(c);
     if (!m_collections.back().color.definite)
     {
         m_collections.back().color = m_plotter.m_color_generator.get_color();
     }
-    m_plotter.add_info_line(InfoLine { m_collections.back().name, m_collections.back().get_color() });
+    m_plotter.add_info_line(m_collections.back().name, m_collections.back().get_color());
+    if (!m_time_axis)
+    {
+        m_time_axis = m_collections.back().data->time_axis();
+        m_dirty_axis = true;
+    }
 }
 
 void SubPlot::add_function(Function const& f)
 {
+    m_dirty = true;
     m_functions.push_back(f);
     if (!m_functions.back().color.definite)
     {
         m_functions.back().color = m_plotter.m_color_generator.get_color();
     }
-    m_plotter.add_info_line(InfoLine { m_functions.back().name, m_functions.back().get_color() });
+    m_plotter.add_info_line(m_functions.back().name, m_functions.back().get_color());
 }
 void SubPlot::set_window(double x, double y, double w, double h)
 {
@@ -918,8 +1364,16 @@ void SubPlot::set_window(double x, double y, double w, double h)
     m_y_offset = -(y - h / 2);
 }
 
+void SubPlot::set_follow(optional<double> width)
+{
+    m_follow = true;
+    m_following = true;
+    m_follow_width = width;
+}
+
 void SubPlot::initialize()
 {
+    release_texture(); // Of the renderer of the previous plot
     if (!m_window_defined)
         initialize_zoom_and_offset();
     m_bottom_margin = m_plotter.text_margin + 2 * m_small_font_advance;
@@ -927,6 +1381,115 @@ void SubPlot::initialize()
     determine_axis();     // This is needed because it computes m_x_label_margin
 }
 
+bool SubPlot::dynamic() const
+{
+    return any_of(m_collections.begin(), m_collections.end(), [](Collection const& c) { return c.data->dynamic(); });
+}
+
+bool SubPlot::update_sources()
+{
+    bool changed = false;
+    for (auto& c : m_collections)
+        changed |= c.data->update();
+    if (m_following)
+        follow_latest();
+    m_dirty |= changed;
+    return changed;
+}
+
+void SubPlot::follow_latest()
+{
+    Bounds bounds;
+    for (auto const& c : m_collections)
+        bounds.extend(source_bounds(*c.data)); // Kept up to date by the sources, so this does not depend on the number of points
+    if (bounds.empty())
+        return;
+    if (m_follow_width)
+    {
+        m_x_zoom = (double)m_width / *m_follow_width;
+        m_y_x_ratio = m_y_zoom / m_x_zoom;
+    }
+    double const x_offset = (double)m_width / (2 * m_x_zoom) - bounds.x_max; // The right edge is at bounds.x_max
+    if (x_offset != m_x_offset)
+    {
+        m_x_offset = x_offset;
+        m_dirty_axis = true;
+    }
+}
+
+void SubPlot::rebase_x_origin()
+{
+    // Relative x are doubles : far from the origin, they cannot tell timestamps apart anymore
+    double const center = -m_x_offset;
+    if (!m_time_axis || !(abs(center) > x_origin_rebase_distance))
+        return;
+    constexpr double limit = 4e18;
+    int64_t const shift = llround(clamp(center, -limit, limit));
+    int64_t origin;
+    if (__builtin_add_overflow(m_time_axis->origin, shift, &origin))
+        return;
+    m_time_axis->origin = origin;
+    m_x_offset += static_cast<double>(shift);
+    m_content_view.x_offset += static_cast<double>(shift);
+    m_dirty = true; // Everything drawn or prefetched is relative to the former origin
+    m_dirty_axis = true;
+}
+
+View SubPlot::source_view(View const& view, DataSource const& d) const
+{
+    if (view.x_origin == 0 || d.time_axis())
+        return view;
+    double const shift = static_cast<double>(view.x_origin);
+    return { view.x_min + shift, view.x_max + shift, view.columns, view.decimate };
+}
+
+void SubPlot::prefetch_requests(vector<Prefetcher::Request>& into) const
+{
+    int const left = hmargin + y_axis_name_size() + m_x_label_margin;
+    double const x_min = from_plot_x(left);
+    double const x_max = from_plot_x(left + m_width);
+    double const w = x_max - x_min;
+    double const column = w / m_width;
+    auto const add = [&](Collection const& c, double from, double to, double column_width) {
+        View const view { from, to, static_cast<size_t>(llround((to - from) / column_width)), true, x_origin() };
+        into.push_back({ c.data, source_view(view, *c.data) });
+    };
+    // The most likely first : pans of up to a view width, then any zoom by one step, wherever the mouse is
+    for (auto const& c : m_collections)
+        if (c.data->thread_safe() && c.data->sorted_by_x())
+            add(c, x_min - w, x_max + w, column);
+    for (auto const& c : m_collections)
+    {
+        if (!c.data->thread_safe() || !c.data->sorted_by_x())
+            continue;
+        add(c, x_min, x_max, column / zoom_factor);
+        add(c, x_min - (zoom_factor - 1.) * w, x_max + (zoom_factor - 1.) * w, column * zoom_factor);
+    }
+}
+
+Bounds SubPlot::source_bounds(DataSource const& d) const
+{
+    Bounds b = d.bounds();
+    auto const time_axis = d.time_axis();
+    double const shift = static_cast<double>((time_axis ? time_axis->origin : 0) - x_origin()); // Exact in int64
+    b.x_min += shift;
+    b.x_max += shift;
+    return b;
+}
+
+pmr::string SubPlot::x_label(double x, bool tick) const
+{
+    pmr::memory_resource* const arena = &m_plotter.m_frame_arena;
+    if (!m_time_axis)
+        return pmr::string(Plotter::to_str(x), arena); // Short enough for to_str's own buffer
+    constexpr double limit = 4e18;
+    int64_t const t = m_time_axis->origin + llround(clamp(x, -limit, limit));
+    if (tick)
+        return time_str(t, m_time_axis->units_per_second, m_x_time_step, false, arena);
+    int64_t const pixel = max<int64_t>(1, llround(min(1. / m_x_zoom, limit))); // What the mouse can point at
+    return time_str(t, m_time_axis->units_per_second, pixel, true, arena);
+}
+
 void SubPlot::initialize_zoom_and_offset()
 {
     m_window_defined = true;
@@ -940,32 +1503,19 @@ void SubPlot::initialize_zoom_and_offset()
         return;
     }
 
-    double x_max = m_collections.front().points.front().x;
-    double x_min = m_collections.front().points.front().x;
-    double y_max = m_collections.front().points.front().y;
-    double y_min = m_collections.front().points.front().y;
+    Bounds bounds;
     for (auto const& c : m_collections)
     {
-        for (auto const& e : c.points)
-        {
-            if (e.x > x_max)
-            {
-                x_max = e.x;
-            }
-            if (e.x < x_min)
-            {
-                x_min = e.x;
-            }
-            if (e.y > y_max)
-            {
-                y_max = e.y;
-            }
-            if (e.y < y_min)
-            {
-                y_min = e.y;
-            }
-        }
+        bounds.extend(source_bounds(*c.data)); // Cached by the dataset, so this does not depend on the number of points
+    }
+    if (bounds.empty())
+    {
+        bounds = { -1., 1., -1., 1. };
     }
+    double const x_max = bounds.x_max;
+    double const x_min = bounds.x_min;
+    double const y_max = bounds.y_max;
+    double const y_min = bounds.y_min;
     double delta_x = x_max - x_min;
     double delta_y = y_max - y_min;
     m_x_zoom = (double)m_width / delta_x;
@@ -987,6 +1537,7 @@ void SubPlot::initialize_zoom_and_offset()
 
 void SubPlot::event_x_move(int x)
 {
+    m_following = false;
     m_x_offset += x / m_x_zoom;
     m_dirty_axis = true;
 }
@@ -999,6 +1550,7 @@ void SubPlot::event_y_move(int y)
 
 void SubPlot::event_zoom(float mouse_wheel, int mouse_x, int mouse_y)
 {
+    m_follow_width.reset(); // When following, the zoom chosen by the user is kept
     double x = from_plot_x(mouse_x);
     double y = from_plot_y(mouse_y);
     double back_x_zoom = m_x_zoom;
@@ -1052,20 +1604,6 @@ int SubPlot::height() const
     return top_margin + title_size() + m_height + x_axis_name_size() + m_bottom_margin;
 }
 
-vector<SubPlot::InfoLine> SubPlot::infos() const
-{
-    vector<InfoLine> r;
-    for (auto const& e : m_collections)
-    {
-        r.push_back({ e.name, e.get_color() });
-    }
-    for (auto const& e : m_functions)
-    {
-        r.push_back({ e.name, e.get_color() });
-    }
-    return r;
-}
-
 void Plotter::update_mouse_position()
 {
     SDL_GetMouseState(&m_mouse_x, &m_mouse_y);
@@ -1125,8 +1663,8 @@ int Plotter::base_y_of_hovered_subplot() const
     return out_of_the_screen;
 }
 
-void Plotter::add_info_line(SubPlot::InfoLine const& i)
+void Plotter::add_info_line(string_view name, SDL_Color color)
 {
-    m_infos.push_back(i);
+    m_infos.push_back(SubPlot::InfoLine { pmr::string(name, m_resource), color });
 }
 }
\ No newline at end of file
@@ -0,0 +1,135 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#include <algorithm>
+#include <plotter/prefetch.hpp>
+
+namespace plotter
+{
+
+using namespace std;
+
+Prefetcher::Prefetcher(size_t budget, size_t threads)
+    : m_budget(budget)
+{
+    for (size_t i = 0; i < threads; i++)
+        m_threads.emplace_back([this] { work(); });
+}
+
+Prefetcher::~Prefetcher()
+{
+    {
+        lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (auto& t : m_threads)
+        t.join();
+}
+
+void Prefetcher::request(vector<Request> requests)
+{
+    {
+        lock_guard lock(m_mutex);
+        m_pending.clear();
+        for (auto& r : requests)
+        {
+            if (!r.source || !r.view.decimate || r.view.columns == 0 || !(r.view.x_min < r.view.x_max) || find_locked(*r.source, r.view))
+                continue;
+            if (any_of(m_in_flight.begin(), m_in_flight.end(), [&](Request const& f) { return covers(f.source.get(), f.view, *r.source, r.view); }))
+                continue;
+            m_pending.push_back(std::move(r));
+        }
+    }
+    m_wake.notify_all();
+}
+
+shared_ptr<Prefetcher::Entry const> Prefetcher::find(DataSource const& source, View const& view)
+{
+    lock_guard lock(m_mutex);
+    return find_locked(source, view);
+}
+
+shared_ptr<Prefetcher::Entry const> Prefetcher::find_locked(DataSource const& source, View const& view)
+{
+    auto const it = find_if(m_lru.begin(), m_lru.end(), [&](auto const& e) { return covers(e->source.get(), e->view, source, view); });
+    if (it == m_lru.end())
+        return nullptr;
+    m_lru.splice(m_lru.begin(), m_lru, it);
+    return m_lru.front();
+}
+
+bool Prefetcher::covers(DataSource const* cached_source, View const& e, DataSource const& source, View const& view)
+{
+    if (cached_source != &source || !view.decimate || e.x_origin != view.x_origin || view.columns == 0)
+        return false;
+    if (view.x_min < e.x_min || view.x_max > e.x_max)
+        return false;
+    // Columns at least as fine as the ones asked, but not so fine that drawing them would cost much more
+    double const column = (view.x_max - view.x_min) / view.columns;
+    double const cached_column = (e.x_max - e.x_min) / e.columns;
+    return cached_column <= column * (1. + 1e-9) && cached_column * max_density_ratio >= column;
+}
+
+span<Coordinate const> Prefetcher::points_in(Entry const& entry, View const& view)
+{
+    auto const& points = entry.points;
+    auto first = lower_bound(points.begin(), points.end(), view.x_min, [](Coordinate const& c, double x) { return c.x < x; });
+    auto last = upper_bound(first, points.end(), view.x_max, [](double x, Coordinate const& c) { return x < c.x; });
+    if (first != points.begin())
+        --first;
+    if (last != points.end())
+        ++last;
+    return { first, last };
+}
+
+size_t Prefetcher::cached_bytes() const
+{
+    lock_guard lock(m_mutex);
+    return m_cached_bytes;
+}
+
+void Prefetcher::work()
+{
+    pmr::vector<Coordinate> scratch; // Kept between views, so that it stops growing
+    unique_lock lock(m_mutex);
+    while (true)
+    {
+        m_wake.wait(lock, [this] { return m_stopping || !m_pending.empty(); });
+        if (m_stopping)
+            return;
+        auto const r = m_in_flight.insert(m_in_flight.end(), std::move(m_pending.front()));
+        m_pending.pop_front();
+        lock.unlock();
+        auto const points = r->source->visible(r->view, scratch);
+        auto entry = make_shared<Entry>(Entry { r->source, r->view, vector<Coordinate>(points.begin(), points.end()) });
+        size_t const bytes = entry->points.size() * sizeof(Coordinate);
+        lock.lock();
+        m_in_flight.erase(r);
+        if (bytes > m_budget || find_locked(*entry->source, entry->view))
+            continue; // Too large, or cached meanwhile : a second entry would take the budget twice
+        m_lru.push_front(std::move(entry));
+        m_cached_bytes += bytes;
+        while (m_cached_bytes > m_budget)
+        {
+            m_cached_bytes -= m_lru.back()->points.size() * sizeof(Coordinate);
+            m_lru.pop_back();
+        }
+    }
+}
+}
@@ -0,0 +1,225 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <plotter/shm.hpp>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace plotter
+{
+
+using namespace std;
+
+namespace
+{
+constexpr char magic[8] = { 'P', 'L', 'T', 'R', 'I', 'N', 'G', '1' };
+
+// Rings are shared in place with producers in other languages, which expect the documented layout
+void require_little_endian(string const& name)
+{
+    if (endian::native != endian::little)
+        throw runtime_error("shared ring " + name + " is little-endian, and this machine is not");
+}
+
+size_t ring_bytes(size_t capacity)
+{
+    return sizeof(SharedRingHeader) + 2 * capacity * sizeof(Coordinate);
+}
+}
+
+SharedRing::SharedRing(string const& name, size_t capacity)
+    : m_name(name)
+    , m_bytes(ring_bytes(capacity))
+{
+    require_little_endian(name);
+    if (capacity == 0)
+        throw runtime_error("a shared ring needs a capacity");
+    // An existing ring is never truncated, as readers which have it mapped would fault : it is used again if it has the
+    // same capacity, and its write sequence goes on, so that its readers keep following it
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    bool const created = fd >= 0;
+    if (!created && errno == EEXIST)
+        fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+        throw runtime_error("cannot create shared memory " + name);
+    struct stat st;
+    bool const sized = created ? ftruncate(fd, m_bytes) == 0 : fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) == m_bytes;
+    void* p = sized ? mmap(nullptr, m_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (p == MAP_FAILED)
+    {
+        if (created)
+            shm_unlink(name.c_str());
+        throw runtime_error(sized ? "cannot map shared memory " + name : name + " exists with another capacity");
+    }
+    m_header = static_cast<SharedRingHeader*>(p);
+    m_slots = reinterpret_cast<Coordinate*>(static_cast<std::byte*>(p) + sizeof(SharedRingHeader));
+    if (memcmp(m_header->magic, magic, sizeof(magic)) == 0)
+    {
+        if (m_header->capacity != capacity || m_header->header_size != sizeof(SharedRingHeader))
+        {
+            munmap(p, m_bytes);
+            throw runtime_error(name + " exists with another capacity");
+        }
+        return;
+    }
+    m_header = new (p) SharedRingHeader {}; // Created, or left before it was ready : no reader uses it
+    m_header->capacity = capacity;
+    m_header->header_size = sizeof(SharedRingHeader);
+    // Readers check the magic last
+    atomic_thread_fence(memory_order_release);
+    memcpy(m_header->magic, magic, sizeof(magic));
+}
+
+SharedRing::~SharedRing()
+{
+    munmap(m_header, m_bytes);
+    shm_unlink(m_name.c_str());
+}
+
+void SharedRing::push(double x, double y)
+{
+    Coordinate const c { x, y };
+    push(span<Coordinate const> { &c, 1 });
+}
+
+void SharedRing::push(span<Coordinate const> points)
+{
+    uint64_t const capacity = m_header->capacity;
+    uint64_t const sequence = m_header->write_sequence.load(memory_order_relaxed);
+    for (size_t k = 0; k < points.size(); k++)
+    {
+        size_t const slot = (sequence + k) % capacity;
+        m_slots[slot] = points[k];
+        m_slots[slot + capacity] = points[k];
+    }
+    m_header->write_sequence.store(sequence + points.size(), memory_order_release);
+    notify_new_data(); // Readers of the same process are woken up, the other ones see the ring at their next check
+}
+
+SharedRingSource::SharedRingSource(string const& name, size_t guard)
+    : m_sequence(0)
+{
+    require_little_endian(name);
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        throw runtime_error("cannot open shared memory " + name);
+    struct stat st;
+    void* p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(SharedRingHeader))
+        p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+        throw runtime_error("cannot map shared memory " + name);
+    m_bytes = st.st_size;
+    m_header = static_cast<SharedRingHeader const*>(p);
+    if (memcmp(m_header->magic, magic, sizeof(magic)) != 0 || m_header->capacity == 0 || m_header->header_size < sizeof(SharedRingHeader)
+        || m_header->header_size + 2 * m_header->capacity * sizeof(Coordinate) > m_bytes)
+    {
+        munmap(p, m_bytes);
+        throw runtime_error(name + " is not a shared ring");
+    }
+    m_capacity = m_header->capacity;
+    m_slots = reinterpret_cast<Coordinate const*>(static_cast<std::byte const*>(p) + m_header->header_size);
+    m_guard = guard == 0 ? m_capacity / 4 : min<uint64_t>(guard, m_capacity - 1);
+}
+
+SharedRingSource::~SharedRingSource()
+{
+    munmap(const_cast<SharedRingHeader*>(m_header), m_bytes);
+}
+
+shared_ptr<SharedRingSource> SharedRingSource::attach(string const& name, size_t guard)
+{
+    return make_shared<SharedRingSource>(name, guard);
+}
+
+bool SharedRingSource::update()
+{
+    uint64_t const sequence = m_header->write_sequence.load(memory_order_acquire);
+    if (sequence == m_sequence)
+        return false;
+    if (sequence < m_sequence)
+    {
+        // The producer created the ring again
+        m_sequence = 0;
+        m_bounds = {};
+    }
+    // Only the new samples, which have not been overwritten yet, are read. The ones the producer overwrote while they
+    // were read are skipped, as visible() drops them
+    uint64_t const kept = m_capacity - m_guard;
+    uint64_t first = max(m_sequence, sequence > kept ? sequence - kept : 0);
+    Bounds added;
+    while (first < sequence)
+    {
+        added = {};
+        for (uint64_t i = first; i < sequence; i++)
+        {
+            Coordinate const& c = m_slots[i % m_capacity];
+            added.extend(c.x, c.y);
+        }
+        atomic_thread_fence(memory_order_acquire);
+        uint64_t const now = m_header->write_sequence.load(memory_order_acquire);
+        uint64_t const valid_from = now + m_guard > m_capacity ? now + m_guard - m_capacity : 0;
+        if (valid_from <= first)
+            break;
+        first = valid_from;
+        added = {};
+    }
+    m_bounds.extend(added);
+    m_sequence = sequence;
+    return true;
+}
+
+span<Coordinate const> SharedRingSource::points() const
+{
+    uint64_t const kept = min(m_sequence, m_capacity - m_guard);
+    uint64_t const first = m_sequence - kept;
+    return { m_slots + first % m_capacity, kept };
+}
+
+span<Coordinate const> SharedRingSource::visible(View const& view, pmr::vector<Coordinate>& scratch) const
+{
+    span<Coordinate const> const kept = points();
+    auto first = lower_bound(kept.begin(), kept.end(), view.x_min, [](Coordinate const& c, double x) { return c.x < x; });
+    auto last = upper_bound(first, kept.end(), view.x_max, [](double x, Coordinate const& c) { return x < c.x; });
+    if (first != kept.begin())
+        --first;
+    if (last != kept.end())
+        ++last;
+    // The points are copied, then the write sequence is read again, like a seqlock : the samples the producer may have
+    // overwritten meanwhile, including the ones of a batch it has not published yet, are dropped
+    scratch.assign(first, last);
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t const sequence = m_header->write_sequence.load(memory_order_acquire);
+    uint64_t const index = m_sequence - kept.size() + (first - kept.begin());
+    uint64_t const valid_from = sequence + m_guard > m_capacity ? sequence + m_guard - m_capacity : 0;
+    if (index < valid_from)
+        scratch.erase(scratch.begin(), scratch.begin() + min<uint64_t>(valid_from - index, scratch.size()));
+    if (view.decimate && scratch.size() > view.columns * decimation_points_per_column)
+        scratch.resize(decimate(scratch, view));
+    return scratch;
+}
+}
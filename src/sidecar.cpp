@@ -0,0 +1,238 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#include <bit>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <plotter/sidecar.hpp>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace plotter
+{
+
+using namespace std;
+
+namespace
+{
+// Sidecar files are written and read in place : a big-endian machine could only read them by swapping every value
+void require_little_endian(string const& path)
+{
+    if (endian::native != endian::little)
+        throw runtime_error(path + " is little-endian, and this machine is not");
+}
+
+constexpr char magic[8] = { 'P', 'L', 'T', 'C', 'A', 'C', 'H', '1' };
+
+// Followed by the points, then by each level of the pyramid. Every section is 8 bytes aligned.
+struct FileHeader
+{
+    char magic[8];
+    uint64_t source_size;
+    int64_t source_mtime; // In nanoseconds
+    uint64_t count;
+    uint64_t sorted_by_x;
+    Bounds bounds;
+    uint64_t base_block;
+    uint64_t level_fanout;
+    uint64_t level_count;
+};
+
+struct LevelEntry
+{
+    uint64_t offset;
+    uint64_t size; // In tiles
+};
+
+struct Stamp
+{
+    uint64_t size;
+    int64_t mtime;
+};
+
+Stamp stamp(string const& path)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        throw runtime_error("cannot stat " + path);
+    return { static_cast<uint64_t>(st.st_size), static_cast<int64_t>(st.st_mtim.tv_sec) * 1'000'000'000 + st.st_mtim.tv_nsec };
+}
+
+void write_all(int fd, void const* data, size_t size, string const& path)
+{
+    auto const* p = static_cast<char const*>(data);
+    while (size > 0)
+    {
+        ssize_t n = ::write(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            throw runtime_error("cannot write " + path);
+        p += n;
+        size -= n;
+    }
+}
+
+// Checks that `count` items of `item` bytes at `offset` are inside the file and aligned, without overflowing
+void check_section(uint64_t offset, uint64_t count, size_t item, MappedFile const& file, string const& path)
+{
+    uint64_t bytes;
+    uint64_t end;
+    if (__builtin_mul_overflow(count, item, &bytes) || __builtin_add_overflow(offset, bytes, &end) || end > file.size() || offset % 8 != 0)
+        throw runtime_error(path + " is truncated or corrupted");
+}
+
+FileHeader const& header_of(MappedFile const& file, string const& path)
+{
+    if (file.size() < sizeof(FileHeader) || memcmp(file.data(), magic, sizeof(magic)) != 0)
+        throw runtime_error(path + " is not a sidecar file");
+    return *reinterpret_cast<FileHeader const*>(file.data());
+}
+}
+
+SidecarSource::SidecarSource(string const& path)
+    : m_file((require_little_endian(path), path))
+{
+    FileHeader const& h = header_of(m_file, path);
+    if (h.base_block != MinMaxPyramid::base_block || h.level_fanout != MinMaxPyramid::level_fanout)
+        throw runtime_error(path + " was written with another pyramid layout");
+    size_t const levels_offset = sizeof(FileHeader);
+    check_section(levels_offset, h.level_count, sizeof(LevelEntry), m_file, path);
+    size_t const points_offset = levels_offset + h.level_count * sizeof(LevelEntry);
+    check_section(points_offset, h.count, sizeof(Coordinate), m_file, path);
+    // The mapping is page aligned and every section is 8 bytes aligned, so the points can be used in place
+    m_points = { reinterpret_cast<Coordinate const*>(m_file.data() + points_offset), h.count };
+    m_bounds = h.bounds;
+    m_sorted_by_x = h.sorted_by_x != 0;
+
+    auto const* entries = reinterpret_cast<LevelEntry const*>(m_file.data() + levels_offset);
+    vector<span<MinMaxPyramid::Tile const>> levels;
+    uint64_t expected = (h.count + MinMaxPyramid::base_block - 1) / MinMaxPyramid::base_block; // Tiles of the level, as build() makes them
+    for (size_t l = 0; l < h.level_count; l++)
+    {
+        check_section(entries[l].offset, entries[l].size, sizeof(MinMaxPyramid::Tile), m_file, path);
+        if (entries[l].size != expected)
+            throw runtime_error(path + " is corrupted");
+        expected = (expected + MinMaxPyramid::level_fanout - 1) / MinMaxPyramid::level_fanout;
+        levels.emplace_back(reinterpret_cast<MinMaxPyramid::Tile const*>(m_file.data() + entries[l].offset), entries[l].size);
+    }
+    m_pyramid.assign(levels);
+}
+
+span<Coordinate const> SidecarSource::visible(View const& view, pmr::vector<Coordinate>& scratch) const
+{
+    if (!m_sorted_by_x)
+        return m_points;
+    return visible_sorted(m_points, view, scratch, [this]() -> MinMaxPyramid const& { return m_pyramid; });
+}
+
+bool SidecarSource::up_to_date(string const& path, string const& source_path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    FileHeader h;
+    bool const read = ::pread(fd, &h, sizeof(h), 0) == sizeof(h);
+    ::close(fd);
+    if (!read || memcmp(h.magic, magic, sizeof(magic)) != 0)
+        return false;
+    Stamp const s = stamp(source_path);
+    return h.source_size == s.size && h.source_mtime == s.mtime;
+}
+
+void SidecarSource::write(string const& path, Dataset const& data, string const& source_path)
+{
+    require_little_endian(path);
+    Stamp const s = stamp(source_path);
+    MinMaxPyramid const none;
+    MinMaxPyramid const& pyramid = data.sorted_by_x() ? data.pyramid() : none; // Only sorted points are decimated
+
+    FileHeader h;
+    memcpy(h.magic, magic, sizeof(magic));
+    h.source_size = s.size;
+    h.source_mtime = s.mtime;
+    h.count = data.size();
+    h.sorted_by_x = data.sorted_by_x();
+    h.bounds = data.bounds();
+    h.base_block = MinMaxPyramid::base_block;
+    h.level_fanout = MinMaxPyramid::level_fanout;
+    h.level_count = pyramid.levels();
+
+    vector<LevelEntry> entries;
+    uint64_t offset = sizeof(FileHeader) + h.level_count * sizeof(LevelEntry) + h.count * sizeof(Coordinate);
+    for (size_t l = 0; l < pyramid.levels(); l++)
+    {
+        entries.push_back({ offset, pyramid.level(l).size() });
+        offset += pyramid.level(l).size_bytes();
+    }
+
+    // Written next to the sidecar, then renamed, so that a sidecar is never seen half written
+    string const temporary = path + ".tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        throw runtime_error("cannot create " + temporary);
+    try
+    {
+        write_all(fd, &h, sizeof(h), temporary);
+        write_all(fd, entries.data(), entries.size() * sizeof(LevelEntry), temporary);
+        write_all(fd, data.points().data(), data.points().size_bytes(), temporary);
+        for (size_t l = 0; l < pyramid.levels(); l++)
+            write_all(fd, pyramid.level(l).data(), pyramid.level(l).size_bytes(), temporary);
+    }
+    catch (...)
+    {
+        ::close(fd);
+        ::unlink(temporary.c_str());
+        throw;
+    }
+    if (::close(fd) != 0 || rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        ::unlink(temporary.c_str());
+        throw runtime_error("cannot write " + path);
+    }
+}
+
+shared_ptr<DataSource> SidecarSource::open(string const& source_path, function<shared_ptr<Dataset>(string const&)> const& load)
+{
+    string const path = path_for(source_path);
+    if (up_to_date(path, source_path))
+    {
+        try
+        {
+            return make_shared<SidecarSource>(path);
+        }
+        catch (runtime_error const&)
+        {
+            // Written by another version : it is replaced below
+        }
+    }
+    shared_ptr<Dataset> data = load(source_path);
+    try
+    {
+        write(path, *data, source_path);
+    }
+    catch (runtime_error const&)
+    {
+    }
+    return data;
+}
+}
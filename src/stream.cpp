@@ -0,0 +1,443 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <plotter/stream.hpp>
+#include <stdexcept>
+
+namespace plotter
+{
+
+using namespace std;
+
+SpscQueue::SpscQueue(size_t capacity, pmr::memory_resource* resource)
+    : m_buffer(bit_ceil(max<size_t>(capacity, 2)), Coordinate { 0., 0. }, resource)
+    , m_mask(m_buffer.size() - 1)
+    , m_head(0)
+    , m_tail(0)
+    , m_cached_head(0)
+{ }
+
+size_t SpscQueue::try_push(span<Coordinate const> points)
+{
+    size_t const tail = m_tail.load(std::memory_order_relaxed);
+    size_t room = m_buffer.size() - (tail - m_cached_head);
+    if (room < points.size())
+    {
+        m_cached_head = m_head.load(std::memory_order_acquire);
+        room = m_buffer.size() - (tail - m_cached_head);
+    }
+    size_t const count = min(room, points.size());
+    for (size_t i = 0; i < count; i++)
+        m_buffer[(tail + i) & m_mask] = points[i];
+    m_tail.store(tail + count, std::memory_order_release);
+    return count;
+}
+
+StreamSource::StreamSource(StreamOptions options, pmr::memory_resource* resource)
+    : m_options(options)
+    , m_queue(options.queue_capacity, resource)
+    , m_dropped(0)
+    , m_points(resource)
+    , m_total(0)
+    , m_last_inversion(0)
+    , m_last_x(0.)
+    , m_random(options.seed)
+    , m_replaced_by(resource)
+    , m_incoming(resource)
+    , m_x_min(resource)
+    , m_x_max(resource)
+    , m_y_min(resource)
+    , m_y_max(resource)
+    , m_aggregates(resource)
+{
+    if (m_options.retention != Retention::All && m_options.capacity == 0)
+        throw runtime_error("a stream which does not keep every point needs a capacity");
+    if (m_options.retention == Retention::Latest)
+        m_points.resize(2 * m_options.capacity, Coordinate { 0., 0. });
+    if (m_options.retention == Retention::Sample)
+    {
+        m_points.reserve(m_options.capacity);
+        m_replaced_by.assign(m_options.capacity, -1);
+    }
+}
+
+shared_ptr<StreamSource> StreamSource::make(StreamOptions options, pmr::memory_resource* resource)
+{
+    return allocate_shared<StreamSource>(pmr::polymorphic_allocator<StreamSource>(resource), options, resource);
+}
+
+bool StreamSource::push(double x, double y)
+{
+    Coordinate const c { x, y };
+    return push(span<Coordinate const> { &c, 1 }) == 1;
+}
+
+size_t StreamSource::push(span<Coordinate const> points)
+{
+    size_t const pushed = m_queue.try_push(points);
+    if (pushed < points.size())
+        m_dropped.fetch_add(points.size() - pushed, std::memory_order_relaxed);
+    if (pushed > 0)
+        notify_new_data();
+    return pushed;
+}
+
+bool StreamSource::update()
+{
+    bool const changed = m_queue.drain([this](span<Coordinate const> points) {
+        for (auto const& c : points)
+            take(c);
+    }) > 0;
+    if (!m_incoming.empty())
+        merge_sample();
+    return changed;
+}
+
+void StreamSource::take(Coordinate const& c)
+{
+    uint64_t const i = m_total;
+    if (i > 0 && c.x < m_last_x)
+        m_last_inversion = i;
+    m_last_x = c.x;
+    if (m_options.retention == Retention::All)
+    {
+        m_points.push_back(c);
+        m_bounds.extend(c.x, c.y);
+        m_total++;
+        return;
+    }
+    if (m_options.retention == Retention::Sample)
+    {
+        sample(c);
+        m_bounds.extend(c.x, c.y);
+        m_total++;
+        return;
+    }
+    size_t const slot = i % m_options.capacity;
+    m_points[slot] = c;
+    m_points[slot + m_options.capacity] = c;
+    m_total++;
+    track(m_x_min, i, &Coordinate::x, true);
+    track(m_x_max, i, &Coordinate::x, false);
+    track(m_y_min, i, &Coordinate::y, true);
+    track(m_y_max, i, &Coordinate::y, false);
+}
+
+void StreamSource::sample(Coordinate const& c)
+{
+    size_t const k = m_options.capacity;
+    auto uniform = [this]() { return uniform_real_distribution<double>(numeric_limits<double>::min(), 1.)(m_random); };
+    auto skip = [this, &uniform]() { return static_cast<uint64_t>(floor(log(uniform()) / log1p(-m_w))) + 1; };
+    if (m_total < k)
+    {
+        m_points.push_back(c);
+        if (m_total + 1 == k)
+        {
+            m_w = exp(log(uniform()) / k);
+            m_next_sampled = m_total + skip();
+        }
+        return;
+    }
+    if (m_total != m_next_sampled)
+        return;
+    size_t const j = uniform_int_distribution<size_t>(0, k - 1)(m_random);
+    if (m_replaced_by[j] >= 0)
+        m_incoming[m_replaced_by[j]].x = numeric_limits<double>::quiet_NaN(); // Itself replaced before being merged
+    m_replaced_by[j] = m_incoming.size();
+    m_incoming.push_back(c);
+    m_w *= exp(log(uniform()) / k);
+    m_next_sampled += skip();
+}
+
+void StreamSource::merge_sample()
+{
+    size_t kept = 0;
+    for (size_t j = 0; j < m_points.size(); j++)
+    {
+        if (m_replaced_by[j] < 0)
+            m_points[kept++] = m_points[j];
+        m_replaced_by[j] = -1;
+    }
+    m_points.resize(kept);
+    for (auto const& c : m_incoming)
+        if (!isnan(c.x))
+            m_points.push_back(c);
+    m_incoming.clear();
+}
+
+void StreamSource::track(pmr::deque<uint64_t>& extremes, uint64_t i, double Coordinate::*axis, bool lowest)
+{
+    uint64_t const start = window_start();
+    while (!extremes.empty() && extremes.front() < start)
+        extremes.pop_front(); // Evicted
+    double const v = at(i).*axis;
+    if (isnan(v))
+        return;
+    auto value = [this, axis](uint64_t k) { return at(k).*axis; };
+    while (!extremes.empty() && (lowest ? value(extremes.back()) >= v : value(extremes.back()) <= v))
+        extremes.pop_back(); // Can never be the extremum anymore
+    extremes.push_back(i);
+}
+
+Coordinate const& StreamSource::at(uint64_t i) const
+{
+    return m_options.retention == Retention::Latest ? m_points[i % m_options.capacity] : m_points[i];
+}
+
+span<Coordinate const> StreamSource::points() const
+{
+    if (m_options.retention != Retention::Latest)
+        return m_points;
+    uint64_t const start = window_start();
+    return { m_points.data() + start % m_options.capacity, m_total - start };
+}
+
+Bounds StreamSource::bounds() const
+{
+    if (m_options.retention != Retention::Latest || m_y_min.empty())
+        return m_bounds;
+    return { at(m_x_min.front()).x, at(m_x_max.front()).x, at(m_y_min.front()).y, at(m_y_max.front()).y };
+}
+
+span<Coordinate const> StreamSource::visible(View const& view, pmr::vector<Coordinate>& scratch) const
+{
+    span<Coordinate const> const kept = points();
+    if (!sorted_by_x())
+        return kept;
+    auto first = lower_bound(kept.begin(), kept.end(), view.x_min, [](Coordinate const& c, double x) { return c.x < x; });
+    auto last = upper_bound(first, kept.end(), view.x_max, [](double x, Coordinate const& c) { return x < c.x; });
+    if (first != kept.begin())
+        --first;
+    if (last != kept.end())
+        ++last;
+    if (!view.decimate || size_t(last - first) <= view.columns * decimation_points_per_column)
+        return { first, last };
+    if (m_options.retention == Retention::Sample)
+    {
+        // The sample is small, and changes everywhere
+        scratch.assign(first, last);
+        scratch.resize(decimate(scratch, view));
+        return scratch;
+    }
+    return aggregated(view, scratch);
+}
+
+void StreamSource::ColumnAggregate::add(uint64_t i, Coordinate const& c)
+{
+    if (count++ == 0)
+    {
+        i_first = i_low = i_high = i;
+        first = low = high = c;
+    }
+    else if (c.y < low.y)
+    {
+        i_low = i;
+        low = c;
+    }
+    else if (c.y > high.y)
+    {
+        i_high = i;
+        high = c;
+    }
+    i_last = i;
+    last = c;
+}
+
+void StreamSource::aggregate_columns(ViewAggregates const& a, int64_t first, int64_t last, pmr::vector<ColumnAggregate>& into) const
+{
+    into.assign(last - first + 1, ColumnAggregate {});
+    span<Coordinate const> const kept = points();
+    uint64_t const start = window_start();
+    auto from = lower_bound(kept.begin(), kept.end(), first, [&a](Coordinate const& c, int64_t k) { return a.column_of(c.x) < k; });
+    for (auto p = from; p != kept.end() && a.column_of(p->x) <= last; ++p)
+        into[a.column_of(p->x) - first].add(start + (p - kept.begin()), *p);
+}
+
+StreamSource::ViewAggregates& StreamSource::aggregates_of(View const& view, double column_width) const
+{
+    // The ones of the same grid whose columns overlap the view, as moving keeps most of them
+    int64_t const first = static_cast<int64_t>(floor(view.x_min / column_width));
+    int64_t const last = static_cast<int64_t>(floor(view.x_max / column_width));
+    ViewAggregates* replaced = nullptr;
+    for (auto& a : m_aggregates)
+    {
+        bool const same_grid = a.x_origin == view.x_origin && abs(column_width - a.column_width) <= 1e-9 * a.column_width;
+        if (same_grid && (a.columns.empty() || (a.first_column <= last && a.first_column + (int64_t)a.columns.size() > first)))
+        {
+            a.last_used = ++m_aggregates_clock;
+            return a;
+        }
+        if (replaced == nullptr || a.last_used < replaced->last_used)
+            replaced = &a;
+    }
+    if (m_aggregates.size() < max_aggregated_views)
+        replaced = &m_aggregates.emplace_back(m_aggregates.get_allocator().resource());
+    replaced->columns.clear();
+    replaced->column_width = column_width;
+    replaced->x_origin = view.x_origin;
+    replaced->aggregated_until = 0;
+    replaced->aggregated_from = window_start();
+    replaced->last_used = ++m_aggregates_clock;
+    return *replaced;
+}
+
+span<Coordinate const> StreamSource::aggregated(View const& view, pmr::vector<Coordinate>& scratch) const
+{
+    double const width = (view.x_max - view.x_min) / max<size_t>(view.columns, 1);
+    if (!(width > 0.) || !isfinite(width))
+    {
+        span<Coordinate const> const kept = points();
+        scratch.assign(kept.begin(), kept.end());
+        scratch.resize(decimate(scratch, view));
+        return scratch;
+    }
+    ViewAggregates& a = aggregates_of(view, width);
+    int64_t const first = a.column_of(view.x_min);
+    int64_t const last = a.column_of(view.x_max);
+    span<Coordinate const> const kept = points();
+    uint64_t const start = window_start();
+
+    // Evicted points can be in the columns of the oldest points, which are computed again
+    if (start != a.aggregated_from && !kept.empty())
+        while (!a.columns.empty() && a.first_column <= a.column_of(kept.front().x))
+        {
+            a.columns.pop_front();
+            a.first_column++;
+        }
+    a.aggregated_from = start;
+
+    // New points go in the columns they belong to, if these are already there
+    for (uint64_t i = max(a.aggregated_until, start); i < m_total && !a.columns.empty(); i++)
+    {
+        Coordinate const& c = at(i);
+        int64_t const k = a.column_of(c.x);
+        if (k >= a.first_column && k < a.first_column + (int64_t)a.columns.size())
+            a.columns[k - a.first_column].add(i, c);
+    }
+    a.aggregated_until = m_total;
+
+    // Keep the columns of the view, and compute the ones which came into it
+    while (!a.columns.empty() && a.first_column < first)
+    {
+        a.columns.pop_front();
+        a.first_column++;
+    }
+    while (!a.columns.empty() && a.first_column + (int64_t)a.columns.size() - 1 > last)
+        a.columns.pop_back();
+    pmr::vector<ColumnAggregate> added(scratch.get_allocator().resource());
+    if (a.columns.empty() || a.first_column > last)
+    {
+        a.columns.clear();
+        aggregate_columns(a, first, last, added);
+        a.columns.assign(added.begin(), added.end());
+        a.first_column = first;
+    }
+    else
+    {
+        if (a.first_column > first)
+        {
+            aggregate_columns(a, first, a.first_column - 1, added);
+            a.columns.insert(a.columns.begin(), added.begin(), added.end());
+            a.first_column = first;
+        }
+        int64_t const back = a.first_column + a.columns.size() - 1;
+        if (back < last)
+        {
+            aggregate_columns(a, back + 1, last, added);
+            a.columns.insert(a.columns.end(), added.begin(), added.end());
+        }
+    }
+
+    // One point on each side of the view, so that lines reach the borders
+    scratch.clear();
+    auto before = lower_bound(kept.begin(), kept.end(), first, [&a](Coordinate const& c, int64_t k) { return a.column_of(c.x) < k; });
+    if (before != kept.begin())
+        scratch.push_back(*prev(before));
+    for (auto const& column : a.columns)
+    {
+        if (column.count == 0)
+            continue;
+        bool const low_first = column.i_low <= column.i_high;
+        uint64_t const indices[] = { column.i_first, low_first ? column.i_low : column.i_high, low_first ? column.i_high : column.i_low, column.i_last };
+        Coordinate const* points[] = { &column.first, low_first ? &column.low : &column.high, low_first ? &column.high : &column.low, &column.last };
+        for (size_t k = 0; k < 4; k++)
+            if (k == 0 || indices[k] != indices[k - 1])
+                scratch.push_back(*points[k]);
+    }
+    auto after = upper_bound(kept.begin(), kept.end(), last, [&a](int64_t k, Coordinate const& c) { return k < a.column_of(c.x); });
+    if (after != kept.end())
+        scratch.push_back(*after);
+    return scratch;
+}
+
+FrameSource::FrameSource(pmr::memory_resource* resource)
+    : m_frames { Frame { resource }, Frame { resource }, Frame { resource } }
+    , m_back(0)
+    , m_front(1)
+    , m_ready(2)
+{ }
+
+shared_ptr<FrameSource> FrameSource::make(pmr::memory_resource* resource)
+{
+    return allocate_shared<FrameSource>(pmr::polymorphic_allocator<FrameSource>(resource), resource);
+}
+
+void FrameSource::publish()
+{
+    Frame& f = m_frames[m_back];
+    f.bounds = {};
+    f.sorted_by_x = true;
+    for (size_t i = 0; i < f.points.size(); i++)
+    {
+        f.bounds.extend(f.points[i].x, f.points[i].y);
+        if (i > 0 && f.points[i].x < f.points[i - 1].x)
+            f.sorted_by_x = false;
+    }
+    if (f.sorted_by_x)
+        f.pyramid.build(f.points.size(), [&f](size_t i) { return f.points[i].y; });
+    // A frame that was never taken is simply replaced : the render loop only wants the newest one
+    m_back = m_ready.exchange(m_back | fresh, std::memory_order_acq_rel) & ~fresh;
+    notify_new_data();
+}
+
+void FrameSource::publish(span<Coordinate const> points)
+{
+    back().assign(points.begin(), points.end());
+    publish();
+}
+
+bool FrameSource::update()
+{
+    if ((m_ready.load(std::memory_order_relaxed) & fresh) == 0)
+        return false;
+    m_front = m_ready.exchange(m_front, std::memory_order_acq_rel) & ~fresh;
+    return true;
+}
+
+span<Coordinate const> FrameSource::visible(View const& view, pmr::vector<Coordinate>& scratch) const
+{
+    Frame const& f = m_frames[m_front];
+    if (!f.sorted_by_x)
+        return f.points;
+    return visible_sorted(f.points, view, scratch, [&f]() -> MinMaxPyramid const& { return f.pyramid; });
+}
+}
@@ -0,0 +1,334 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <plotter/tail.hpp>
+#include <stdexcept>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace plotter
+{
+
+using namespace std;
+
+namespace
+{
+constexpr size_t batch_size = 4096;
+}
+
+TailSource::TailSource(string const& path, variant<Csv, Raw> format, StreamOptions options, pmr::memory_resource* resource)
+    : m_path(path)
+    , m_format(std::move(format))
+    , m_options(options)
+    , m_resource(resource)
+    , m_fd(-1)
+    , m_inotify(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+    , m_watch(-1)
+    , m_directory_watch(-1)
+    , m_file_name(filesystem::path(path).filename())
+    , m_offset(0)
+    , m_buffer(resource)
+    , m_batch(resource)
+    , m_stream(StreamSource::make(options, resource))
+{
+    if (Raw const* raw = get_if<Raw>(&m_format))
+    {
+        if (raw->x.offset + dtype_size(raw->x.type) > raw->record_size || raw->y.offset + dtype_size(raw->y.type) > raw->record_size)
+            throw runtime_error(path + " : x and y must be inside a record");
+    }
+    else
+    {
+        Csv const& csv = get<Csv>(m_format);
+        if (!csv.options.header && (!csv.x.index || !csv.y.index))
+            throw runtime_error(path + " : columns can only be given by their names if there is a header");
+    }
+    if (m_inotify >= 0)
+    {
+        string const directory = filesystem::path(path).parent_path();
+        m_directory_watch = inotify_add_watch(m_inotify, directory.empty() ? "." : directory.c_str(), IN_CREATE | IN_MOVED_TO);
+    }
+    try
+    {
+        open();
+        m_batch.reserve(batch_size);
+        read_appended();
+        if (m_error)
+            throw runtime_error(*m_error); // Only the files which come next are skipped
+    }
+    catch (...)
+    {
+        if (m_fd >= 0)
+            close(m_fd);
+        if (m_inotify >= 0)
+            close(m_inotify);
+        throw;
+    }
+}
+
+TailSource::~TailSource()
+{
+    if (m_fd >= 0)
+        close(m_fd);
+    if (m_inotify >= 0)
+        close(m_inotify); // Removes its watches
+}
+
+shared_ptr<TailSource> TailSource::csv(string const& path, CsvColumn x, CsvColumn y, CsvOptions csv_options, StreamOptions options)
+{
+    return make_shared<TailSource>(path, Csv { std::move(x), std::move(y), csv_options }, options);
+}
+
+shared_ptr<TailSource> TailSource::raw(string const& path, ColumnLayout x, ColumnLayout y, size_t record_size, StreamOptions options)
+{
+    return make_shared<TailSource>(path, Raw { x, y, record_size }, options);
+}
+
+// Opens the file at m_path, and reads it from its beginning
+void TailSource::open()
+{
+    int fd = ::open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw runtime_error("cannot open " + m_path);
+    if (m_fd >= 0)
+        close(m_fd);
+    m_fd = fd;
+    if (m_inotify >= 0)
+    {
+        if (m_watch >= 0)
+            inotify_rm_watch(m_inotify, m_watch); // Fails if the old file was removed, which removed the watch
+        m_watch = inotify_add_watch(m_inotify, m_path.c_str(), IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF);
+    }
+    m_offset = 0;
+    m_buffer.clear();
+    m_dropping_line = false;
+    m_skipping = false;
+    m_error.reset();
+    if (Csv const* csv = get_if<Csv>(&m_format))
+    {
+        m_x_index = csv->options.header ? nullopt : csv->x.index;
+        m_y_index = csv->options.header ? nullopt : csv->y.index;
+    }
+}
+
+// The file was rewritten : its points are forgotten
+void TailSource::restart()
+{
+    m_stream = StreamSource::make(m_options, m_resource);
+    m_offset = 0;
+    m_buffer.clear();
+    m_dropping_line = false;
+    m_skipping = false;
+    if (Csv const* csv = get_if<Csv>(&m_format); csv != nullptr && csv->options.header)
+    {
+        m_x_index.reset();
+        m_y_index.reset();
+    }
+}
+
+bool TailSource::replaced() const
+{
+    struct stat path_st;
+    struct stat fd_st;
+    if (stat(m_path.c_str(), &path_st) != 0 || fstat(m_fd, &fd_st) != 0)
+        return false; // Moved, and not created again yet
+    return path_st.st_ino != fd_st.st_ino || path_st.st_dev != fd_st.st_dev;
+}
+
+bool TailSource::update()
+{
+    bool appended = m_inotify < 0;
+    bool moved = m_inotify < 0;
+    if (m_inotify >= 0)
+    {
+        alignas(inotify_event) char events[4096];
+        ssize_t n;
+        while ((n = read(m_inotify, events, sizeof(events))) > 0)
+        {
+            for (char const* p = events; p < events + n;)
+            {
+                inotify_event const* e = reinterpret_cast<inotify_event const*>(p);
+                if (e->mask & IN_Q_OVERFLOW)
+                {
+                    // Events were lost : anything may have happened
+                    appended = true;
+                    moved = true;
+                }
+                else if (e->wd == m_watch)
+                {
+                    appended |= (e->mask & IN_MODIFY) != 0;
+                    moved |= (e->mask & (IN_MOVE_SELF | IN_DELETE_SELF)) != 0;
+                }
+                else if (e->wd == m_directory_watch && e->len > 0 && m_file_name == e->name)
+                    moved = true;
+                p += sizeof(inotify_event) + e->len;
+            }
+        }
+    }
+    if (!appended && !moved)
+        return false;
+    // This is called by the render loop : failing to follow the file must not close the window
+    bool changed = false;
+    try
+    {
+        changed = read_appended(); // What was written before the file was replaced
+        if (moved && replaced())
+        {
+            open();
+            changed |= read_appended();
+        }
+    }
+    catch (exception const& e)
+    {
+        m_error = e.what();
+    }
+    return changed;
+}
+
+// Reads and parses what was appended since the last time, by blocks of read_size
+bool TailSource::read_appended()
+{
+    struct stat st;
+    if (fstat(m_fd, &st) != 0)
+        throw runtime_error("cannot read " + m_path);
+    uint64_t const size = st.st_size;
+    bool changed = false;
+    if (size < m_offset)
+    {
+        restart();
+        changed = true;
+    }
+    if (m_skipping)
+        m_offset = size;
+    while (m_offset < size)
+    {
+        size_t const kept = m_buffer.size();
+        size_t const wanted = min<uint64_t>(read_size, size - m_offset);
+        m_buffer.resize(kept + wanted);
+        ssize_t const n = pread(m_fd, m_buffer.data() + kept, wanted, m_offset);
+        if (n < 0 && errno == EINTR)
+        {
+            m_buffer.resize(kept);
+            continue;
+        }
+        if (n < 0)
+            throw runtime_error("cannot read " + m_path);
+        m_buffer.resize(kept + n);
+        if (n == 0)
+            break; // Truncated in between
+        m_offset += n;
+        if (m_dropping_line)
+        {
+            auto const newline = find(m_buffer.begin(), m_buffer.end(), '\n');
+            m_dropping_line = newline == m_buffer.end();
+            m_buffer.erase(m_buffer.begin(), newline == m_buffer.end() ? newline : newline + 1);
+        }
+        char const* rest = parse(m_buffer.data(), m_buffer.data() + m_buffer.size());
+        m_buffer.erase(m_buffer.begin(), m_buffer.begin() + (rest - m_buffer.data()));
+        if (m_skipping)
+        {
+            m_offset = size;
+            m_buffer.clear();
+        }
+        else if (m_buffer.size() > max_line_size)
+        {
+            m_buffer.clear(); // A line which never ends would fill the memory
+            m_dropping_line = true;
+        }
+    }
+    flush();
+    return m_stream->update() || changed;
+}
+
+char const* TailSource::parse(char const* begin, char const* end)
+{
+    if (Csv const* csv = get_if<Csv>(&m_format))
+        return parse_csv(begin, end, *csv);
+    return parse_raw(begin, end, get<Raw>(m_format));
+}
+
+// Lines which cannot be read are skipped, as a log can hold other lines
+char const* TailSource::parse_csv(char const* begin, char const* end, Csv const& csv)
+{
+    char const separator = csv.options.separator;
+    char const* p = begin;
+    while (p < end)
+    {
+        char const* newline = static_cast<char const*>(memchr(p, '\n', end - p));
+        if (newline == nullptr)
+            break; // Not completely written yet
+        char const* line_end = newline;
+        if (line_end > p && line_end[-1] == '\r')
+            line_end--;
+        if (!m_x_index)
+        {
+            try
+            {
+                m_x_index = csv_column_index(csv.x, p, line_end, separator, m_path);
+                m_y_index = csv_column_index(csv.y, p, line_end, separator, m_path);
+            }
+            catch (exception const& e)
+            {
+                m_x_index.reset();
+                m_error = e.what();
+                m_skipping = true;
+                return end;
+            }
+        }
+        else if (Coordinate c { 0., 0. }; parse_csv_line(p, line_end, separator, *m_x_index, *m_y_index, c))
+            add(c);
+        p = newline + 1;
+    }
+    return p;
+}
+
+char const* TailSource::parse_raw(char const* begin, char const* end, Raw const& raw)
+{
+    size_t const records = (end - begin) / raw.record_size;
+    Column const x { reinterpret_cast<std::byte const*>(begin) + raw.x.offset, raw.record_size, raw.x.type };
+    Column const y { reinterpret_cast<std::byte const*>(begin) + raw.y.offset, raw.record_size, raw.y.type };
+    for (size_t i = 0; i < records; i++)
+        add({ x[i], y[i] });
+    return begin + records * raw.record_size;
+}
+
+void TailSource::add(Coordinate const& c)
+{
+    m_batch.push_back(c);
+    if (m_batch.size() == batch_size)
+        flush();
+}
+
+// The stream is only used from this thread, which takes the points in itself when its queue is full
+void TailSource::flush()
+{
+    span<Coordinate const> left = m_batch;
+    while (!left.empty())
+    {
+        left = left.subspan(m_stream->push(left));
+        if (!left.empty())
+            m_stream->update();
+    }
+    m_batch.clear();
+}
+}
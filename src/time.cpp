@@ -0,0 +1,175 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <plotter/time.hpp>
+#include <stdexcept>
+
+namespace plotter
+{
+
+using namespace std;
+
+namespace
+{
+// origin + x rounded down, or up, saturated to the range of int64
+int64_t timestamp(int64_t origin, double x, double (*round)(double))
+{
+    constexpr double limit = 9.2e18;
+    int64_t t;
+    if (__builtin_add_overflow(origin, static_cast<int64_t>(round(clamp(x, -limit, limit))), &t))
+        return x < 0. ? numeric_limits<int64_t>::min() : numeric_limits<int64_t>::max();
+    return t;
+}
+}
+
+TimeSource::TimeSource(pmr::vector<int64_t> x, pmr::vector<double> y, int64_t units_per_second)
+    : m_x(move(x))
+    , m_y(move(y))
+    , m_units_per_second(units_per_second)
+    , m_origin(0)
+    , m_sorted_by_x(true)
+    , m_pyramid(m_x.get_allocator().resource())
+{
+    if (m_x.size() != m_y.size())
+        throw runtime_error("x and y must have the same size");
+    if (units_per_second <= 0)
+        throw runtime_error("a time source needs a positive number of units per second");
+    if (m_x.empty())
+        return;
+    auto const [x_min, x_max] = minmax_element(m_x.begin(), m_x.end());
+    m_origin = *x_min;
+    m_sorted_by_x = is_sorted(m_x.begin(), m_x.end());
+    for (size_t i = 0; i < m_x.size(); i++)
+        m_bounds.extend(static_cast<double>(m_x[i] - m_origin), m_y[i]);
+    if (m_sorted_by_x)
+        m_pyramid.build(m_y.size(), [this](size_t i) { return m_y[i]; });
+}
+
+shared_ptr<TimeSource> TimeSource::make(span<int64_t const> x, span<double const> y, int64_t units_per_second, pmr::memory_resource* resource)
+{
+    return make_shared<TimeSource>(pmr::vector<int64_t>(x.begin(), x.end(), resource), pmr::vector<double>(y.begin(), y.end(), resource), units_per_second);
+}
+
+span<Coordinate const> TimeSource::visible(View const& view, pmr::vector<Coordinate>& scratch) const
+{
+    auto relative = [&view, this](size_t i) { return Coordinate { static_cast<double>(m_x[i] - view.x_origin), m_y[i] }; };
+    scratch.clear();
+    if (!m_sorted_by_x)
+    {
+        scratch.reserve(m_x.size());
+        for (size_t i = 0; i < m_x.size(); i++)
+            scratch.push_back(relative(i));
+        return scratch;
+    }
+    // Search the timestamps themselves, so that the range is exact whatever the origin
+    int64_t const x_min = timestamp(view.x_origin, view.x_min, floor);
+    int64_t const x_max = timestamp(view.x_origin, view.x_max, ceil);
+    auto first = lower_bound(m_x.begin(), m_x.end(), x_min);
+    auto last = upper_bound(first, m_x.end(), x_max);
+    if (first != m_x.begin())
+        --first;
+    if (last != m_x.end())
+        ++last;
+    size_t const i_first = first - m_x.begin();
+    size_t const i_last = last - m_x.begin();
+    if (!view.decimate || i_last - i_first <= view.columns * decimation_points_per_column)
+    {
+        scratch.reserve(i_last - i_first);
+        for (size_t i = i_first; i < i_last; i++)
+            scratch.push_back(relative(i));
+        return scratch;
+    }
+    m_pyramid.select(i_first, i_last, view.columns, [this](size_t i) { return m_y[i]; }, [&](size_t i) { scratch.push_back(relative(i)); });
+    return scratch;
+}
+
+int64_t time_grid_step(int max_nb, double range, int64_t units_per_second)
+{
+    int64_t const second = units_per_second;
+    int64_t const minute = 60 * second;
+    int64_t const hour = 60 * minute;
+    int64_t const day = 24 * hour;
+    double const max_ticks = max(max_nb, 1);
+    auto fits = [&](int64_t step) { return range / (double)step <= max_ticks; };
+    // Decimal fractions of a second
+    for (int64_t unit = 1; unit < second; unit *= 10)
+    {
+        for (int64_t factor : { 1, 2, 5 })
+        {
+            if (factor * unit < second && second % (factor * unit) == 0 && fits(factor * unit))
+                return factor * unit;
+        }
+    }
+    for (int64_t step : { second, 2 * second, 5 * second, 10 * second, 15 * second, 30 * second,
+             minute, 2 * minute, 5 * minute, 10 * minute, 15 * minute, 30 * minute,
+             hour, 2 * hour, 3 * hour, 6 * hour, 12 * hour,
+             day, 2 * day, 7 * day, 14 * day })
+    {
+        if (fits(step))
+            return step;
+    }
+    // Then days, by 1, 2 and 5 times powers of 10
+    for (int64_t unit = 10 * day; unit < numeric_limits<int64_t>::max() / 50; unit *= 10)
+    {
+        for (int64_t factor : { 1, 2, 5 })
+        {
+            if (fits(factor * unit))
+                return factor * unit;
+        }
+    }
+    return numeric_limits<int64_t>::max() / 10;
+}
+
+pmr::string time_str(int64_t t, int64_t units_per_second, int64_t resolution, bool with_date, pmr::memory_resource* resource)
+{
+    // Formatted in place : dates and times are longer than the string's own buffer, so the result is allocated from resource
+    auto floor_div = [](int64_t a, int64_t b) { return a / b - (a % b < 0); };
+    int64_t const seconds = floor_div(t, units_per_second);
+    int64_t const fraction = t - seconds * units_per_second;
+    int64_t const days = floor_div(seconds, 86'400);
+    int64_t const second_of_day = seconds - days * 86'400;
+    chrono::year_month_day const date { chrono::sys_days { chrono::days { days } } };
+    char buffer[64];
+    int n = 0;
+    if (with_date || resolution >= 86'400 * units_per_second || (second_of_day == 0 && fraction == 0))
+        n = snprintf(buffer, sizeof(buffer), "%04d-%02u-%02u", int(date.year()), unsigned(date.month()), unsigned(date.day()));
+    if (!with_date && (resolution >= 86'400 * units_per_second || (second_of_day == 0 && fraction == 0)))
+        return pmr::string(buffer, n, resource); // Ticks at midnight only show the date
+    if (n > 0)
+        buffer[n++] = ' ';
+    n += snprintf(buffer + n, sizeof(buffer) - n, "%02d:%02d", int(second_of_day / 3600), int(second_of_day / 60 % 60));
+    if (resolution < 60 * units_per_second)
+        n += snprintf(buffer + n, sizeof(buffer) - n, ":%02d", int(second_of_day % 60));
+    // As many decimals as the resolution needs
+    int decimals = 0;
+    int64_t unit = units_per_second;
+    while (unit > resolution && unit % 10 == 0)
+    {
+        unit /= 10;
+        decimals++;
+    }
+    if (decimals > 0)
+        n += snprintf(buffer + n, sizeof(buffer) - n, ".%0*lld", decimals, static_cast<long long>(fraction / unit));
+    return pmr::string(buffer, n, resource);
+}
+}
@@ -16,14 +16,476 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 SPDX identifier : GPL-3.0-or-later
 */
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <plotter/plotter.hpp>
+#include <thread>
 
 using namespace std;
 using namespace plotter;
 
+// CompressedSource is lossless : every bit of x and y comes back, with an irregular x, NaN and infinities
+bool compressed_round_trip()
+{
+    constexpr double inf = numeric_limits<double>::infinity();
+    vector<Coordinate> points;
+    double x = -1e6;
+    for (size_t i = 0; i < 3 * CompressedSource::block_size + 7; i++)
+    {
+        x += 0.001 * (1 + (i * 7919) % 13);
+        double y = 1e3 * sin(0.01 * i);
+        if (i % 97 == 0)
+            y = numeric_limits<double>::quiet_NaN();
+        else if (i % 101 == 0)
+            y = inf;
+        else if (i % 103 == 0)
+            y = -inf;
+        points.push_back({ x, y });
+    }
+    points.front().x = -inf;
+    points.back().x = inf;
+    auto source = CompressedSource::make(points);
+    pmr::vector<Coordinate> scratch;
+    auto decoded = source->visible({ -inf, inf, 1, false }, scratch);
+    if (decoded.size() != points.size())
+        return false;
+    for (size_t i = 0; i < points.size(); i++)
+        if (memcmp(&decoded[i].x, &points[i].x, sizeof(double)) != 0 || memcmp(&decoded[i].y, &points[i].y, sizeof(double)) != 0)
+            return false;
+    return true;
+}
+
+// Writes a .npy file of version 1.0 made of header and of data
+void write_npy(string const& path, string const& header, span<double const> data)
+{
+    string const padded = header + string(63 - (10 + header.size()) % 64, ' ') + '\n'; // The data is aligned on 64 bytes
+    ofstream file { path, ios::binary };
+    file.write("\x93NUMPY\x01\x00", 8);
+    file.put(static_cast<char>(padded.size() & 0xff));
+    file.put(static_cast<char>(padded.size() >> 8));
+    file << padded;
+    file.write(reinterpret_cast<char const*>(data.data()), data.size_bytes());
+}
+
+// MappedSource reads the columns of a .npy file in C and Fortran order, and refuses the malformed ones
+bool npy_parsing()
+{
+    vector<double> const c_order { 0, 10, 1, 11, 2, 12 };
+    vector<double> const fortran_order { 0, 1, 2, 10, 11, 12 };
+    pmr::vector<Coordinate> scratch;
+    for (auto [fortran, data] : { pair { "False", c_order }, pair { "True", fortran_order } })
+    {
+        write_npy("test.npy", string("{'descr': '<f8', 'fortran_order': ") + fortran + ", 'shape': (3, 2), }", data);
+        auto points = MappedSource::open_npy("test.npy")->visible({ 0, 2, 10, false }, scratch);
+        if (points.size() != 3)
+            return false;
+        for (size_t i = 0; i < points.size(); i++)
+            if (points[i].x != i || points[i].y != 10 + i)
+                return false;
+    }
+    vector<string> const malformed {
+        "{'descr'",                                                                             // Truncated
+        "{'descr': '>f8', 'fortran_order': False, 'shape': (3, 2), }",                          // Big-endian
+        "{'descr': '<f8', 'fortran_order': False, 'shape': (3, 2",                              // Unterminated shape
+        "{'descr': '<f8', 'fortran_order': False, 'shape': (4, 2), }",                          // Fewer values than the shape
+        "{'descr': '<f8', 'fortran_order': False, 'shape': (99999999999999999999999, 2), }",    // Out of size_t
+        "{'descr': '<f8', 'fortran_order': False, 'shape': (4611686018427387904, 4), }",        // Overflowing size
+        "{'descr': '<f8', 'fortran_order': False, 'shape': (1, 2, 3), }",                       // 3-D
+    };
+    for (auto const& header : malformed)
+    {
+        write_npy("test.npy", header, c_order);
+        try
+        {
+            MappedSource::open_npy("test.npy");
+            return false;
+        }
+        catch (runtime_error const&)
+        {
+        }
+    }
+    return true;
+}
+
+// load_csv finds the columns by name or index, skips empty lines and refuses the fields which are not numbers
+bool csv_parsing()
+{
+    {
+        ofstream file { "test.csv", ios::binary };
+        file << "time, value ,other\r\n";
+        for (int i = 0; i < 1000; i++)
+        {
+            file << i << "," << -0.5 * i << "," << 1000 - i << "\r\n";
+            if (i % 100 == 0)
+                file << "\n";
+        }
+    }
+    for (size_t threads : { 1, 4 }) // Parsed in parallel, the lines cut between two threads must still be read once
+    {
+        auto dataset = load_csv("test.csv", "time", "value", { .threads = threads });
+        if (dataset->size() != 1000 || !dataset->sorted_by_x())
+            return false;
+        for (size_t i = 0; i < dataset->size(); i++)
+            if (dataset->points()[i].x != i || dataset->points()[i].y != -0.5 * i)
+                return false;
+    }
+    auto const by_index = load_csv("test.csv", 2, 0);
+    if (by_index->points().front().x != 1000 || by_index->sorted_by_x())
+        return false;
+    Coordinate c;
+    char const line[] = "1;2;x";
+    if (!parse_csv_line(line, line + 3, ';', 0, 1, c) || c.x != 1 || c.y != 2 || parse_csv_line(line, line + 5, ';', 0, 2, c) || parse_csv_line(line, line + 3, ';', 0, 3, c))
+        return false;
+    {
+        ofstream file { "test.csv", ios::binary };
+        file << "1\t2\n3\tx\n";
+    }
+    for (auto const& [x, y] : { pair<CsvColumn, CsvColumn> { 0, 1 }, pair<CsvColumn, CsvColumn> { "time", 1 } })
+    {
+        try
+        {
+            load_csv("test.csv", x, y, { .separator = '\t', .header = !x.name.empty() });
+            return false;
+        }
+        catch (runtime_error const&)
+        {
+        }
+    }
+    return true;
+}
+
+// Buffers of an Arrow array of the test, which tells when it is released
+template <typename T>
+struct ArrowTestColumn
+{
+    vector<T> values;
+    vector<uint8_t> validity;
+    void const* buffers[2] { nullptr, nullptr };
+    bool released { false };
+
+    ArrowArray array(int64_t offset)
+    {
+        buffers[0] = validity.empty() ? nullptr : validity.data();
+        buffers[1] = values.data();
+        int64_t const length = static_cast<int64_t>(values.size()) - offset;
+        auto release = [](ArrowArray* a) {
+            static_cast<ArrowTestColumn*>(a->private_data)->released = true;
+            a->release = nullptr;
+        };
+        return { length, validity.empty() ? 0 : -1, offset, 2, 0, buffers, nullptr, nullptr, release, this };
+    }
+};
+
+ArrowSchema arrow_test_schema(char const* format)
+{
+    return { format, nullptr, nullptr, 0, 0, nullptr, nullptr, [](ArrowSchema* s) { s->release = nullptr; }, nullptr };
+}
+
+// ArrowSource reads timestamps exactly and nulls as gaps, releases the arrays it took, and refuses mismatched ones
+bool arrow_import()
+{
+    constexpr int64_t epoch = 1'700'000'000'000'000'001; // Nanoseconds, out of a double's exact integers
+    ArrowTestColumn<int64_t> x;
+    ArrowTestColumn<double> y;
+    for (int64_t i = 0; i < 20; i++)
+        x.values.push_back(epoch + 1000 * i);
+    for (int64_t i = 0; i < 21; i++) // y starts one value later
+        y.values.push_back(0.5 * i);
+    y.validity.assign(3, 0xff);
+    y.validity[1] = 0xfe; // Value 8, so point 7 once offset
+    {
+        ArrowArray x_array = x.array(0);
+        ArrowArray y_array = y.array(1);
+        ArrowSchema x_schema = arrow_test_schema("tsn:UTC");
+        ArrowSchema y_schema = arrow_test_schema("g");
+        auto source = ArrowSource::make(&x_array, &x_schema, &y_array, &y_schema);
+        if (x_array.release != nullptr || x_schema.release != nullptr || y_schema.release != nullptr || x.released)
+            return false;
+        auto const axis = source->time_axis();
+        if (!axis || axis->units_per_second != 1'000'000'000)
+            return false;
+        pmr::vector<Coordinate> scratch;
+        auto points = source->visible({ -1, 1e6, 10, false, epoch }, scratch);
+        if (points.size() != 20)
+            return false;
+        for (size_t i = 0; i < points.size(); i++)
+            if (points[i].x != 1000. * i || (i == 7 ? !isnan(points[i].y) : points[i].y != 0.5 * (i + 1)))
+                return false;
+    }
+    if (!x.released || !y.released)
+        return false;
+    ArrowArray x_array = x.array(0);
+    ArrowArray longer = y.array(0);
+    ArrowArray same_length = y.array(1);
+    ArrowSchema x_schema = arrow_test_schema("l");
+    ArrowSchema y_schema = arrow_test_schema("g");
+    ArrowSchema unsupported = arrow_test_schema("u"); // UTF-8 strings
+    for (auto [y_array, y_format] : { pair { &longer, &y_schema }, pair { &same_length, &unsupported } })
+    {
+        try
+        {
+            ArrowSource::make(&x_array, &x_schema, y_array, y_format);
+            return false;
+        }
+        catch (runtime_error const&)
+        {
+        }
+    }
+    return x_array.release != nullptr; // Still owned by the caller
+}
+
+// SpscQueue keeps the points in order across its wrap-around, refuses those it has no room for, and hands them
+// from one thread to another
+bool spsc_queue()
+{
+    SpscQueue queue { 5 };
+    if (queue.capacity() != 8)
+        return false;
+    vector<Coordinate> points;
+    for (int i = 0; i < 6; i++)
+        points.push_back({ double(i), -double(i) });
+    vector<Coordinate> drained;
+    auto append = [&](span<Coordinate const> part) { drained.insert(drained.end(), part.begin(), part.end()); };
+    if (queue.try_push(points) != 6 || queue.drain(append) != 6 || queue.try_push(points) != 6 || queue.try_push(points) != 2 || queue.size() != 8)
+        return false;
+    queue.drain(append); // Wraps around the end of the buffer
+    if (drained.size() != 14 || queue.size() != 0)
+        return false;
+    for (size_t i = 0; i < drained.size(); i++)
+        if (drained[i].x != i % 6)
+            return false;
+
+    constexpr size_t n = 1'000'000;
+    SpscQueue shared { 1024 };
+    thread producer { [&] {
+        for (size_t i = 0; i < n;)
+        {
+            Coordinate const c { double(i), 0 };
+            i += shared.try_push({ &c, 1 });
+        }
+    } };
+    size_t received = 0;
+    bool in_order = true;
+    while (received < n)
+        shared.drain([&](span<Coordinate const> part) {
+            for (auto const& c : part)
+                in_order = in_order && c.x == received++;
+        });
+    producer.join();
+    return in_order;
+}
+
+// Retention::Sample keeps `capacity` distinct points of the stream, in order, taken uniformly from all of it, while the
+// bounds stay those of the whole stream
+bool reservoir_sampling()
+{
+    constexpr size_t n = 100'000;
+    constexpr size_t k = 100;
+    size_t first_half = 0;
+    constexpr uint64_t seeds = 50;
+    for (uint64_t seed = 0; seed < seeds; seed++)
+    {
+        auto stream = StreamSource::make({ .retention = Retention::Sample, .capacity = k, .seed = seed });
+        vector<Coordinate> batch;
+        double y_min = 0;
+        double y_max = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            batch.push_back({ double(i), sin(0.001 * i) });
+            y_min = min(y_min, batch.back().y);
+            y_max = max(y_max, batch.back().y);
+            if (batch.size() == 1000)
+            {
+                stream->push(batch);
+                stream->update();
+                batch.clear();
+            }
+        }
+        auto const sample = stream->points();
+        if (stream->total() != n || sample.size() != k || !stream->sorted_by_x())
+            return false;
+        for (size_t i = 0; i < sample.size(); i++)
+            if ((i > 0 && sample[i].x <= sample[i - 1].x) || sample[i].x >= n || sample[i].y != sin(0.001 * sample[i].x))
+                return false;
+        Bounds const b = stream->bounds();
+        if (b.x_min != 0 || b.x_max != n - 1 || b.y_min != y_min || b.y_max != y_max)
+            return false;
+        for (auto const& c : sample)
+            first_half += c.x < n / 2;
+    }
+    double const ratio = double(first_half) / (seeds * k); // 0.5, with a standard deviation of 0.007
+    return ratio > 0.46 && ratio < 0.54;
+}
+
+// SharedRingSource shows the last `capacity - guard` samples of a ring while a producer keeps overwriting it, and
+// never a torn one
+bool shared_ring()
+{
+    SharedRing ring { "/plotter_test", 1024 };
+    auto source = SharedRingSource::attach("/plotter_test");
+    if (source->update() || !source->points().empty())
+        return false;
+    atomic<bool> done { false };
+    thread producer { [&] {
+        for (int i = 0; i < 200'000; i++)
+            ring.push(double(i), double(i % 13));
+        done = true;
+    } };
+    pmr::vector<Coordinate> scratch;
+    bool consistent = true;
+    while (!done)
+    {
+        source->update();
+        if (source->points().size() > 768)
+            consistent = false;
+        auto points = source->visible({ -1, 2e5, 100'000, false }, scratch);
+        for (size_t i = 1; i < points.size(); i++)
+            consistent = consistent && points[i].x == points[i - 1].x + 1 && points[i].y == double(int64_t(points[i].x) % 13);
+    }
+    producer.join();
+    source->update();
+    auto points = source->points();
+    if (!consistent || points.size() != 768 || points.back().x != 199'999 || source->bounds().x_max != 199'999)
+        return false;
+    try
+    {
+        SharedRing other { "/plotter_test", 2048 }; // Of another capacity
+        return false;
+    }
+    catch (runtime_error const&)
+    {
+    }
+    return true;
+}
+
+// TailSource reads what is appended to a file once its lines or records are complete, and starts again when the file
+// is truncated or replaced
+bool tail_following()
+{
+    {
+        ofstream file { "test.log" };
+        file << "t,v\n1,10\n2,20\n3,";
+    }
+    auto log = TailSource::csv("test.log", "t", "v");
+    if (log->points().size() != 2 || log->update())
+        return false;
+    {
+        ofstream file { "test.log", ios::app };
+        file << "30\ngarbage\n4,40\n"; // The incomplete line is finished, and the garbage one is skipped
+    }
+    if (!log->update() || log->points().size() != 4 || log->points().points().back().y != 40 || log->update())
+        return false;
+    {
+        ofstream file { "test.log" }; // Truncated
+        file << "t,v\n100,1\n";
+    }
+    if (!log->update() || log->points().size() != 1 || log->points().points().front().x != 100)
+        return false;
+    filesystem::rename("test.log", "test.log.1");
+    {
+        ofstream file { "test.log" };
+        file << "t,v\n200,2\n";
+    }
+    if (!log->update() || log->error() || log->points().size() != 2 || log->points().points().back().x != 200)
+        return false;
+    filesystem::remove("test.log.1");
+
+    {
+        ofstream file { "test.bin", ios::binary };
+        for (int i = 0; i < 10; i++)
+        {
+            double const x = i;
+            float const y = 2.f * i;
+            file.write(reinterpret_cast<char const*>(&x), sizeof(x));
+            file.write(reinterpret_cast<char const*>(&y), sizeof(y));
+        }
+        file.write("ab", 2); // The beginning of a record
+    }
+    auto records = TailSource::raw("test.bin", { DType::Float64, 0 }, { DType::Float32, 8 }, 12);
+    if (records->points().size() != 10 || records->offset() != 122) // The incomplete record is read, and kept for later
+        return false;
+    {
+        ofstream file { "test.bin", ios::binary | ios::app };
+        file.write(string(10, '\0').data(), 10);
+    }
+    return records->update() && records->points().size() == 11;
+}
+
+// Time axes have ticks at round durations, labeled with as many digits as the step needs, whatever the date
+bool time_ticks()
+{
+    constexpr int64_t ns = TimeSource::nanoseconds;
+    constexpr int64_t day = 86'400;
+    if (time_grid_step(10, 1e9, ns) != ns / 10 || time_grid_step(10, 7e6, ns) != ns / 1000 || time_grid_step(10, 3600, 1) != 600
+        || time_grid_step(5, 30 * day, 1) != 7 * day || time_grid_step(0, 3 * day, 1) != 7 * day || time_grid_step(10, 1e4 * day, 1) != 1000 * day)
+        return false;
+    pmr::monotonic_buffer_resource arena;
+    vector<tuple<int64_t, int64_t, int64_t, bool, char const*>> const labels {
+        { 0, ns, ns, false, "1970-01-01" }, // Ticks at midnight only show the date
+        { 45'296 * ns + ns / 2, ns, ns / 10, false, "12:34:56.5" },
+        { 45'296, 1, 60, false, "12:34" },
+        { 1'700'000'000'123'456'789, ns, 1, true, "2023-11-14 22:13:20.123456789" },
+        { -1, ns, 1, true, "1969-12-31 23:59:59.999999999" },
+        { 3 * day, 1, 7 * day, false, "1970-01-04" },
+    };
+    for (auto const& [t, units_per_second, resolution, with_date, expected] : labels)
+        if (time_str(t, units_per_second, resolution, with_date, &arena) != expected)
+            return false;
+    return true;
+}
+
 int main()
 {
+    if (!compressed_round_trip())
+    {
+        cerr << "CompressedSource does not give back the points it was made from" << endl;
+        return 1;
+    }
+    if (!npy_parsing())
+    {
+        cerr << "MappedSource does not read .npy files right" << endl;
+        return 1;
+    }
+    if (!csv_parsing())
+    {
+        cerr << "load_csv does not read CSV files right" << endl;
+        return 1;
+    }
+    if (!arrow_import())
+    {
+        cerr << "ArrowSource does not import Arrow arrays right" << endl;
+        return 1;
+    }
+    if (!spsc_queue())
+    {
+        cerr << "SpscQueue loses or reorders points" << endl;
+        return 1;
+    }
+    if (!reservoir_sampling())
+    {
+        cerr << "StreamSource does not keep a uniform sample of the stream" << endl;
+        return 1;
+    }
+    if (!shared_ring())
+    {
+        cerr << "SharedRingSource does not show the last samples of the ring" << endl;
+        return 1;
+    }
+    if (!tail_following())
+    {
+        cerr << "TailSource does not follow the file" << endl;
+        return 1;
+    }
+    if (!time_ticks())
+    {
+        cerr << "Time axes do not have round ticks and labels" << endl;
+        return 1;
+    }
+
     Plotter plotter { "Test Plot", "x axis", "y axis", ColorPalette::Default };
 
     plotter.set_window(-10, 10, 20, 20);
@@ -0,0 +1,465 @@
+/*
+Copyright (C) 2024-2025 Louis Crespin
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+SPDX identifier : GPL-3.0-or-later
+*/
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <plotter/plotter.hpp>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+using namespace plotter;
+
+// Plots series read from the standard input, as they come.
+//
+// CSV lines hold x then one y per series, or only y : x is then the number of the line. A first line which is not
+// made of numbers holds the names of the columns.
+//
+// Binary frames hold, in little-endian : the number of samples (uint32), the series (uint32), then as many x and y
+// (float64). Frames are parsed where they were read, in a large buffer : only the end of a frame cut by the end of
+// a read is moved.
+
+namespace
+{
+
+enum class Format
+{
+    Csv,
+    Binary,
+};
+
+struct Options
+{
+    Format format { Format::Csv };
+    char separator { ',' };
+    size_t series { 1 }; // Binary frames only : CSV lines tell how many series there are
+    optional<size_t> latest;
+    optional<double> follow_width;
+    bool points { false };
+    optional<string> save;
+    string title { "plotter" };
+    optional<string> x_title;
+    optional<string> y_title;
+};
+
+constexpr size_t read_size = 4 << 20;
+constexpr size_t batch_size = 4096;
+constexpr size_t frame_header_size = 8;
+constexpr size_t frame_sample_size = 16;
+constexpr size_t max_frame_samples = 1 << 26;
+constexpr size_t queue_capacity = 1 << 20;
+
+void usage()
+{
+    cerr << "usage : plotter [options] < data\n"
+            "  --binary           length-prefixed binary frames instead of CSV lines\n"
+            "  --series N         number of series of binary frames (1)\n"
+            "  --separator C      CSV separator (,), \\t for TSV\n"
+            "  --latest N         only keep the last N points of each series\n"
+            "  --follow WIDTH     show the last WIDTH units of x\n"
+            "  --points           draw points instead of lines\n"
+            "  --save NAME        read everything, then save NAME.png instead of opening a window\n"
+            "  --title T, --x-title T, --y-title T\n";
+}
+
+template<typename T>
+T parse_argument(string_view name, string_view value)
+{
+    T v {};
+    auto result = from_chars(value.data(), value.data() + value.size(), v);
+    if (result.ec != errc() || result.ptr != value.data() + value.size())
+        throw runtime_error("invalid value for " + string(name) + " : " + string(value));
+    return v;
+}
+
+Options parse_options(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        string_view const arg = argv[i];
+        auto value = [&]() -> string_view {
+            if (i + 1 >= argc)
+                throw runtime_error(string(arg) + " needs a value");
+            return argv[++i];
+        };
+        if (arg == "--binary")
+            options.format = Format::Binary;
+        else if (arg == "--series")
+            options.series = parse_argument<size_t>(arg, value());
+        else if (arg == "--separator")
+        {
+            string_view const s = value();
+            if (s == "\\t")
+                options.separator = '\t';
+            else if (s.size() == 1)
+                options.separator = s[0];
+            else
+                throw runtime_error("the separator must be one character");
+        }
+        else if (arg == "--latest")
+            options.latest = parse_argument<size_t>(arg, value());
+        else if (arg == "--follow")
+            options.follow_width = parse_argument<double>(arg, value());
+        else if (arg == "--points")
+            options.points = true;
+        else if (arg == "--save")
+            options.save = string(value());
+        else if (arg == "--title")
+            options.title = value();
+        else if (arg == "--x-title")
+            options.x_title = string(value());
+        else if (arg == "--y-title")
+            options.y_title = string(value());
+        else
+            throw runtime_error("unknown option " + string(arg));
+    }
+    if (options.series == 0 || options.latest == 0)
+        throw runtime_error("--series and --latest must be positive");
+    return options;
+}
+
+// Reads the standard input into one buffer, and parses it there
+class Input
+{
+public:
+    explicit Input(Options const& options, atomic<bool> const& stop)
+        : m_options(options)
+        , m_stop(stop)
+        , m_buffer(read_size)
+        , m_begin(0)
+        , m_end(0)
+        , m_eof(false)
+        , m_line(0)
+        , m_csv_columns(0)
+        , m_drain_inline(true)
+    { }
+
+    // Reads the first line of a CSV input, which tells how many series there are, and their names
+    vector<string> names();
+    void create_series(vector<string> const& names);
+    vector<shared_ptr<StreamSource>> const& series() const { return m_series; }
+    // Whether this thread takes the points in when a queue is full, as there is no render loop yet
+    void set_drain_inline(bool d) { m_drain_inline = d; }
+
+    // Parses what has been read
+    void parse();
+    // Parses what has been read, then waits for more. Returns false at the end of the input.
+    bool step();
+
+private:
+    bool fill(size_t needed);
+    void parse_csv();
+    void parse_binary();
+    void take_csv_line(char const* begin, char const* end);
+    void add(size_t series, Coordinate const& c);
+    void flush(size_t series);
+
+    Options const& m_options;
+    atomic<bool> const& m_stop;
+    vector<char> m_buffer;
+    size_t m_begin; // Not parsed yet : [m_begin, m_end)
+    size_t m_end;
+    bool m_eof;
+    uint64_t m_line; // x of CSV lines with only y
+    size_t m_csv_columns;
+    bool m_drain_inline;
+    vector<shared_ptr<StreamSource>> m_series;
+    vector<vector<Coordinate>> m_batches;
+    vector<double> m_fields;
+};
+
+// Keeps [m_begin, m_end), moved to the beginning of the buffer, and reads until at least needed bytes are there
+bool Input::fill(size_t needed)
+{
+    if (m_begin > 0)
+    {
+        memmove(m_buffer.data(), m_buffer.data() + m_begin, m_end - m_begin);
+        m_end -= m_begin;
+        m_begin = 0;
+    }
+    if (needed > m_buffer.size())
+        m_buffer.resize(needed);
+    while (m_end < needed && !m_eof)
+    {
+        ssize_t const n = read(STDIN_FILENO, m_buffer.data() + m_end, m_buffer.size() - m_end);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            throw runtime_error(string("cannot read the input : ") + strerror(errno));
+        if (n == 0)
+            m_eof = true;
+        m_end += n;
+    }
+    return m_end >= needed;
+}
+
+vector<string> Input::names()
+{
+    while (true)
+    {
+        char const* const begin = m_buffer.data() + m_begin;
+        char const* const end = m_buffer.data() + m_end;
+        char const* newline = static_cast<char const*>(memchr(begin, '\n', end - begin));
+        if (newline == nullptr && !m_eof)
+        {
+            fill(m_end - m_begin + 1);
+            continue;
+        }
+        char const* const line_end = newline == nullptr ? end : newline;
+        if (all_of(begin, line_end, [](char c) { return c == ' ' || c == '\t' || c == '\r'; }))
+        {
+            if (newline == nullptr)
+                throw runtime_error("the input is empty");
+            m_begin = newline + 1 - m_buffer.data();
+            continue;
+        }
+        m_fields.resize(parse_csv_fields(begin, line_end, m_options.separator, {}));
+        parse_csv_fields(begin, line_end, m_options.separator, m_fields);
+        m_csv_columns = m_fields.size();
+        vector<string> names;
+        if (any_of(m_fields.begin(), m_fields.end(), [](double f) { return !isnan(f); }))
+        {
+            for (size_t i = m_fields.size() == 1 ? 0 : 1; i < m_fields.size(); i++)
+                names.push_back("column " + to_string(i));
+            return names; // The line holds data, parsed with the rest
+        }
+        char const* start = begin;
+        while (true)
+        {
+            char const* stop = find(start, line_end, m_options.separator);
+            string_view name(start, stop - start);
+            while (!name.empty() && (name.back() == '\r' || name.back() == ' '))
+                name.remove_suffix(1);
+            while (!name.empty() && name.front() == ' ')
+                name.remove_prefix(1);
+            names.emplace_back(name);
+            if (stop == line_end)
+                break;
+            start = stop + 1;
+        }
+        if (names.size() > 1)
+            names.erase(names.begin()); // The name of x
+        m_begin = (newline == nullptr ? end : newline + 1) - m_buffer.data();
+        return names;
+    }
+}
+
+void Input::create_series(vector<string> const& names)
+{
+    StreamOptions stream_options { .queue_capacity = queue_capacity };
+    if (m_options.latest)
+    {
+        stream_options.retention = Retention::Latest;
+        stream_options.capacity = *m_options.latest;
+    }
+    for (size_t i = 0; i < names.size(); i++)
+        m_series.push_back(StreamSource::make(stream_options));
+    m_batches.resize(names.size());
+    for (auto& b : m_batches)
+        b.reserve(batch_size);
+    m_fields.resize(m_csv_columns);
+}
+
+void Input::parse()
+{
+    if (m_options.format == Format::Csv)
+        parse_csv();
+    else
+        parse_binary();
+    for (size_t i = 0; i < m_series.size(); i++)
+        flush(i);
+}
+
+bool Input::step()
+{
+    parse();
+    if (m_eof)
+        return false;
+    fill(m_end - m_begin + 1);
+    return true;
+}
+
+void Input::parse_csv()
+{
+    char const* p = m_buffer.data() + m_begin;
+    char const* const end = m_buffer.data() + m_end;
+    while (p < end)
+    {
+        char const* newline = static_cast<char const*>(memchr(p, '\n', end - p));
+        if (newline == nullptr && !m_eof)
+            break; // Cut by the end of the read
+        char const* const line_end = newline == nullptr ? end : newline;
+        take_csv_line(p, line_end);
+        p = newline == nullptr ? end : newline + 1;
+    }
+    m_begin = p - m_buffer.data();
+}
+
+void Input::take_csv_line(char const* begin, char const* end)
+{
+    if (all_of(begin, end, [](char c) { return c == ' ' || c == '\t' || c == '\r'; }))
+        return;
+    parse_csv_fields(begin, end, m_options.separator, m_fields);
+    if (m_fields.size() == 1)
+    {
+        add(0, { double(m_line++), m_fields[0] });
+        return;
+    }
+    if (isnan(m_fields[0]))
+        return; // Without x, the line cannot be placed
+    for (size_t i = 1; i < m_fields.size(); i++)
+        add(i - 1, { m_fields[0], m_fields[i] });
+}
+
+void Input::parse_binary()
+{
+    while (m_end - m_begin >= frame_header_size)
+    {
+        char const* const frame = m_buffer.data() + m_begin;
+        uint32_t count;
+        uint32_t series;
+        memcpy(&count, frame, sizeof(count));
+        memcpy(&series, frame + 4, sizeof(series));
+        if (series >= m_series.size())
+            throw runtime_error("frame for series " + to_string(series) + ", but there are " + to_string(m_series.size()) + " series");
+        if (count > max_frame_samples)
+            throw runtime_error("frame of " + to_string(count) + " samples, which is too many");
+        size_t const size = frame_header_size + count * frame_sample_size;
+        if (m_end - m_begin < size)
+        {
+            if (m_eof)
+                throw runtime_error("the input ends in the middle of a frame");
+            if (size > m_buffer.size())
+                fill(size); // Larger than the buffer : waits for the whole frame
+            return;
+        }
+        for (char const* p = frame + frame_header_size; p < frame + size; p += frame_sample_size)
+        {
+            Coordinate c { 0., 0. };
+            memcpy(&c.x, p, sizeof(double));
+            memcpy(&c.y, p + sizeof(double), sizeof(double));
+            add(series, c);
+        }
+        m_begin += size;
+    }
+    if (m_eof && m_end > m_begin)
+        throw runtime_error("the input ends in the middle of a frame");
+}
+
+void Input::add(size_t series, Coordinate const& c)
+{
+    auto& batch = m_batches[series];
+    batch.push_back(c);
+    if (batch.size() == batch_size)
+        flush(series);
+}
+
+// Queues a batch, waiting for the render loop while the queue is full
+void Input::flush(size_t series)
+{
+    auto& batch = m_batches[series];
+    span<Coordinate const> left = batch;
+    while (!left.empty() && !m_stop.load(memory_order_relaxed))
+    {
+        left = left.subspan(m_series[series]->push(left));
+        if (left.empty())
+            break;
+        if (m_drain_inline)
+            m_series[series]->update(); // No render loop yet : this thread takes the points in
+        else
+            this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    batch.clear();
+}
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    try
+    {
+        options = parse_options(argc, argv);
+    }
+    catch (exception const& e)
+    {
+        cerr << "plotter : " << e.what() << endl;
+        usage();
+        return 1;
+    }
+    try
+    {
+        atomic<bool> stop { false };
+        Input input { options, stop };
+        vector<string> names;
+        if (options.format == Format::Csv)
+            names = input.names();
+        else
+            for (size_t i = 0; i < options.series; i++)
+                names.push_back("series " + to_string(i));
+        input.create_series(names);
+
+        Plotter plotter { options.title, options.x_title, options.y_title };
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            DisplayPoints const dp = options.points ? DisplayPoints::Yes : DisplayPoints::No;
+            DisplayLines const dl = options.points ? DisplayLines::No : DisplayLines::Yes;
+            plotter.add_collection(Collection { input.series()[i], names[i], dp, dl, PointType::Cross });
+        }
+
+        if (options.save)
+        {
+            while (input.step())
+                ;
+            plotter.save(*options.save);
+            return 0;
+        }
+
+        // The points already read give the initial window
+        input.parse();
+        for (auto const& s : input.series())
+            s->update();
+        input.set_drain_inline(false);
+        plotter.set_follow(options.follow_width);
+        thread reader([&input, &stop]() {
+            try
+            {
+                while (!stop.load(memory_order_relaxed) && input.step())
+                    ;
+            }
+            catch (exception const& e)
+            {
+                cerr << "plotter : " << e.what() << endl;
+            }
+        });
+        plotter.plot();
+        stop = true;
+        reader.detach(); // It may be waiting for input which never comes
+        _exit(0);        // Without destroying what it uses
+    }
+    catch (exception const& e)
+    {
+        cerr << "plotter : " << e.what() << endl;
+        return 1;
+    }
+}